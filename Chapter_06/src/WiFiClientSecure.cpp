@@ -77,8 +77,11 @@ WiFiClientSecure::WiFiClientSecure(int sock)
 
 WiFiClientSecure::~WiFiClientSecure()
 {
+    sslclient->keep_credentials = false;
     stop();
+    ssl_clear_session(sslclient);
     delete sslclient;
+    free(_writeBuffer);
 }
 
 WiFiClientSecure &WiFiClientSecure::operator=(const WiFiClientSecure &other)
@@ -97,6 +100,7 @@ void WiFiClientSecure::stop()
     _peek = -1;
     _lastReadTimeout = 0;
     _lastWriteTimeout = 0;
+    _asyncState = ASYNC_IDLE;
 }
 
 int WiFiClientSecure::connect(IPAddress ip, uint16_t port)
@@ -154,9 +158,85 @@ int WiFiClientSecure::connect(IPAddress ip, uint16_t port, const char *host, con
         return 0;
     }
     _connected = true;
+    allocateWriteBuffer();
     return 1;
 }
 
+int WiFiClientSecure::connectAsync(const char *host, uint16_t port)
+{
+    IPAddress address;
+    if (!WiFi.hostByName(host, address))
+        return 0;
+
+    return connectAsync(address, port, host);
+}
+
+int WiFiClientSecure::connectAsync(IPAddress ip, uint16_t port, const char *host)
+{
+    if (_connected || _asyncState != ASYNC_IDLE)
+        stop();
+
+    const char *pskIdent = (_pskIdent && _psKey) ? _pskIdent : NULL;
+    const char *psKey = pskIdent ? _psKey : NULL;
+    int ret = start_ssl_client_async(sslclient, ip, port, host, _timeout, pskIdent ? NULL : _CA_cert, _use_ca_bundle, pskIdent ? NULL : _cert, pskIdent ? NULL : _private_key, pskIdent, psKey, _use_insecure, _alpn_protos);
+    _lastError = ret;
+
+    if (ret < 0) {
+        log_e("start_ssl_client_async: connect failed: %d", ret);
+        stop();
+        return 0;
+    }
+    _asyncState = ASYNC_CONNECTING;
+    _asyncStartTime = millis();
+    return 1;
+}
+
+tls_connect_status_t WiFiClientSecure::poll()
+{
+    int ret;
+
+    switch (_asyncState) {
+    case ASYNC_CONNECTING:
+        ret = ssl_poll_connect(sslclient, 0);
+        if (ret == 0) {
+            if ((millis() - _asyncStartTime) <= (unsigned long)_timeout)
+                return TLS_CONNECT_PENDING;
+            log_e("connectAsync: TCP connect timed out after %d ms", _timeout);
+            ret = -1;
+        }
+        if (ret < 0)
+            break;
+        _asyncState = ASYNC_HANDSHAKING;
+        _asyncStartTime = millis();
+        log_v("Performing the SSL/TLS handshake...");
+        return TLS_CONNECT_PENDING;
+
+    case ASYNC_HANDSHAKING:
+        ret = ssl_handshake_step(sslclient);
+        if (ret == 0) {
+            if ((millis() - _asyncStartTime) <= sslclient->handshake_timeout)
+                return TLS_CONNECT_PENDING;
+            log_e("connectAsync: TLS handshake timed out");
+            ret = -1;
+        }
+        if (ret < 0)
+            break;
+        _asyncState = ASYNC_IDLE;
+        _lastError = 0;
+        _connected = true;
+        allocateWriteBuffer();
+        return TLS_CONNECT_READY;
+
+    default:
+        return _connected ? TLS_CONNECT_READY : TLS_CONNECT_FAILED;
+    }
+
+    _lastError = ret;
+    log_e("connectAsync: connect failed: %d", ret);
+    stop();
+    return TLS_CONNECT_FAILED;
+}
+
 int WiFiClientSecure::startTLS()
 {
     int ret = 1;
@@ -169,6 +249,7 @@ int WiFiClientSecure::startTLS()
                 return 0;
         };
         _stillinPlainStart = false;
+        allocateWriteBuffer(); // The record size is known once the handshake is done
     } else 
         log_i("startTLS: ignoring StartTLS - as we should be secure already");
     return 1;
@@ -193,6 +274,7 @@ int WiFiClientSecure::connect(const char *host, uint16_t port, const char *pskId
         return 0;
     }
     _connected = true;
+    allocateWriteBuffer();
     return 1;
 }
 
@@ -217,30 +299,80 @@ int WiFiClientSecure::read()
 }
 
 size_t WiFiClientSecure::write(const uint8_t *buf, size_t size)
+{
+    tls_segment_t segment = { buf, size };
+    return writev(&segment, 1);
+}
+
+size_t WiFiClientSecure::writev(const tls_segment_t *segments, size_t count)
 {
     if (!_connected) {
         return 0;
     }
 
-    if (_stillinPlainStart) 
-        return send_net_data(sslclient, buf, size);
-
-    if(_lastWriteTimeout != _timeout){
-        struct timeval timeout_tv;
-        timeout_tv.tv_sec = _timeout / 1000;
-        timeout_tv.tv_usec = (_timeout % 1000) * 1000;
-        if(setSocketOption(SO_SNDTIMEO, (char *)&timeout_tv, sizeof(struct timeval)) >= 0)
-        {
-            _lastWriteTimeout = _timeout;
+    size_t written = 0;
+    if (_stillinPlainStart) {
+        for (size_t i = 0; i < count; i++) {
+            int res = send_net_data(sslclient, segments[i].data, segments[i].size);
+            if (res < 0) {
+                break;
+            }
+            written += res;
         }
+        return written;
     }
-    int res = send_ssl_data(sslclient, buf, size);
-    if (res < 0) {
-        log_e("Closing connection on failed write");
-        stop();
-        res = 0;
+
+    if (_lastWriteTimeout != _timeout && setTimeoutOption(SO_SNDTIMEO)) {
+        _lastWriteTimeout = _timeout;
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += segments[i].size;
+    }
+    int payload = get_ssl_max_out_payload(sslclient);
+    size_t record = payload > 0 ? payload : 0;
+    size_t capacity = total < record ? total : record;
+    if (capacity > _writeBufferSize) {
+        capacity = _writeBufferSize; // Records of the staging size, should the record size have grown
+    }
+    // A single segment needs no staging; without a buffer every segment goes out on its own
+    uint8_t *staging = (count > 1 && capacity > 0) ? _writeBuffer : NULL;
+
+    size_t staged = 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *data = segments[i].data;
+        size_t size = segments[i].size;
+        while (size > 0) {
+            if (staging == NULL || (staged == 0 && size >= record)) {
+                // Whole records straight from the caller buffer, a tail shorter than a record is staged
+                size_t length = staging == NULL ? size : size - size % record;
+                if (!sendRecords(data, length)) {
+                    return written;
+                }
+                written += length;
+                data += length;
+                size -= length;
+                continue;
+            }
+            size_t length = capacity - staged < size ? capacity - staged : size;
+            memcpy(staging + staged, data, length);
+            staged += length;
+            data += length;
+            size -= length;
+            if (staged == capacity) {
+                if (!sendRecords(staging, staged)) {
+                    return written;
+                }
+                written += staged;
+                staged = 0;
+            }
+        }
+    }
+    if (staged > 0 && sendRecords(staging, staged)) {
+        written += staged;
     }
-    return res;
+    return written;
 }
 
 int WiFiClientSecure::read(uint8_t *buf, size_t size)
@@ -248,39 +380,35 @@ int WiFiClientSecure::read(uint8_t *buf, size_t size)
     if(_stillinPlainStart) 
         return  get_net_receive(sslclient, buf, size);
 
-    if(_lastReadTimeout != _timeout){
-        if(fd() >= 0){
-            struct timeval timeout_tv;
-            timeout_tv.tv_sec = _timeout / 1000;
-            timeout_tv.tv_usec = (_timeout % 1000) * 1000;
-            if(setSocketOption(SO_RCVTIMEO, (char *)&timeout_tv, sizeof(struct timeval)) >= 0)
-            {
-                _lastReadTimeout = _timeout;
-            }
-        }
+    if (_lastReadTimeout != _timeout && fd() >= 0 && setTimeoutOption(SO_RCVTIMEO)) {
+        _lastReadTimeout = _timeout;
     }
 
-    int peeked = 0, res = -1;
-    int avail = available();
-    if ((!buf && size) || avail <= 0) {
+    if (!_connected || (!buf && size)) {
         return -1;
     }
     if(!size){
-        return 0;
+        return available() > 0 ? 0 : -1; // Lets connected() notice a closed connection
     }
+
+    int peeked = 0;
     if(_peek >= 0){
         buf[0] = _peek;
         _peek = -1;
-        size--;
-        avail--;
-        if(!size || !avail){
+        if(size == 1){
             return 1;
         }
         buf++;
+        size--;
         peeked = 1;
     }
-        res = get_ssl_receive(sslclient, buf, size);
 
+    // No available() round first: mbedtls_ssl_read() copies what is left of the current record,
+    // or decrypts the next one, directly into buf and reports WANT_READ while none has arrived
+    int res = get_ssl_receive(sslclient, buf, size);
+    if (res == MBEDTLS_ERR_SSL_WANT_READ || res == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return peeked ? peeked : -1;
+    }
     if (res < 0) {
         log_e("Closing connection on failed read");
         stop();
@@ -289,6 +417,45 @@ int WiFiClientSecure::read(uint8_t *buf, size_t size)
     return res + peeked;
 }
 
+// Apply _timeout as SO_SNDTIMEO or SO_RCVTIMEO
+bool WiFiClientSecure::setTimeoutOption(int option)
+{
+    struct timeval timeout_tv;
+    timeout_tv.tv_sec = _timeout / 1000;
+    timeout_tv.tv_usec = (_timeout % 1000) * 1000;
+    return setSocketOption(option, (char *)&timeout_tv, sizeof(struct timeval)) >= 0;
+}
+
+// Send size bytes as one or more records, closing the connection if a write fails
+bool WiFiClientSecure::sendRecords(const uint8_t *buf, size_t size)
+{
+    while (size > 0) {
+        int res = send_ssl_data(sslclient, buf, size); // At most one record per call
+        if (res <= 0) {
+            log_e("Closing connection on failed write");
+            stop();
+            return false;
+        }
+        buf += res;
+        size -= res;
+    }
+    return true;
+}
+
+// Size the writev() staging buffer to one record payload of the connection. It is kept
+// across reconnects, so it is only allocated again when the negotiated record size grows
+void WiFiClientSecure::allocateWriteBuffer()
+{
+    int payload = get_ssl_max_out_payload(sslclient);
+    size_t size = payload > 0 ? payload : 0;
+    if (size <= _writeBufferSize) {
+        return;
+    }
+    free(_writeBuffer);
+    _writeBuffer = (uint8_t *)malloc(size);
+    _writeBufferSize = _writeBuffer ? size : 0; // Without it writev() sends every segment on its own
+}
+
 int WiFiClientSecure::available()
 {
     if (_stillinPlainStart) 
@@ -328,30 +495,89 @@ void WiFiClientSecure::setInsecure()
 
 void WiFiClientSecure::setCACert (const char *rootCA)
 {
+    sslclient->parsed_ca_buff = NULL; // parse again on connect, the buffer may hold new content
     _CA_cert = rootCA;
+    sslclient->ca_der_len = 0;
+    _use_insecure = false;
+}
+
+void WiFiClientSecure::setCACertDER(const uint8_t *der, size_t length)
+{
+    sslclient->parsed_ca_buff = NULL; // parse again on connect, the buffer may hold new content
+    _CA_cert = (const char *)der;
+    sslclient->ca_der_len = der != NULL ? length : 0;
     _use_insecure = false;
 }
 
- void WiFiClientSecure::setCACertBundle(const uint8_t * bundle)
- {
+// Bytes of an esp_crt_bundle: a 2 byte certificate count, then per certificate a 2 byte
+// name length, a 2 byte key length, the name and the key
+static size_t crt_bundle_size(const uint8_t *bundle)
+{
+    size_t count = (bundle[0] << 8) | bundle[1];
+    const uint8_t *cert = bundle + 2;
+    for (size_t i = 0; i < count; i++) {
+        size_t name_len = (cert[0] << 8) | cert[1];
+        size_t key_len = (cert[2] << 8) | cert[3];
+        cert += 4 + name_len + key_len;
+    }
+    return cert - bundle;
+}
+
+void WiFiClientSecure::setCACertBundle(const uint8_t * bundle)
+{
+    setCACertBundle(bundle, bundle != NULL ? crt_bundle_size(bundle) : 0);
+}
+
+void WiFiClientSecure::setCACertBundle(const uint8_t *bundle, size_t size)
+{
     if (bundle != NULL)
     {
-        esp_crt_bundle_set(bundle, sizeof(bundle));
+        esp_crt_bundle_set(bundle, size);
         _use_ca_bundle = true;
     } else {
         esp_crt_bundle_detach(NULL);
         _use_ca_bundle = false;
     }
- }
+}
 
 void WiFiClientSecure::setCertificate (const char *client_ca)
 {
+    sslclient->parsed_cert_buff = NULL; // parse again on connect, the buffer may hold new content
     _cert = client_ca;
+    sslclient->cert_der_len = 0;
+}
+
+void WiFiClientSecure::setCertificateDER(const uint8_t *der, size_t length)
+{
+    sslclient->parsed_cert_buff = NULL; // parse again on connect, the buffer may hold new content
+    _cert = (const char *)der;
+    sslclient->cert_der_len = der != NULL ? length : 0;
 }
 
 void WiFiClientSecure::setPrivateKey (const char *private_key)
 {
+    sslclient->parsed_key_buff = NULL; // parse again on connect, the buffer may hold new content
     _private_key = private_key;
+    sslclient->key_der_len = 0;
+}
+
+void WiFiClientSecure::setPrivateKeyDER(const uint8_t *der, size_t length)
+{
+    sslclient->parsed_key_buff = NULL; // parse again on connect, the buffer may hold new content
+    _private_key = (const char *)der;
+    sslclient->key_der_len = der != NULL ? length : 0;
+}
+
+bool WiFiClientSecure::setMaxFragmentLength(size_t length)
+{
+    switch (length) {
+    case 0:    sslclient->max_frag_len = MBEDTLS_SSL_MAX_FRAG_LEN_NONE; return true;
+    case 512:  sslclient->max_frag_len = MBEDTLS_SSL_MAX_FRAG_LEN_512;  return true;
+    case 1024: sslclient->max_frag_len = MBEDTLS_SSL_MAX_FRAG_LEN_1024; return true;
+    case 2048: sslclient->max_frag_len = MBEDTLS_SSL_MAX_FRAG_LEN_2048; return true;
+    case 4096: sslclient->max_frag_len = MBEDTLS_SSL_MAX_FRAG_LEN_4096; return true;
+    default:   return false;
+    }
 }
 
 void WiFiClientSecure::setPreSharedKey(const char *pskIdent, const char *psKey) {
@@ -383,6 +609,7 @@ char *WiFiClientSecure::_streamLoad(Stream& stream, size_t size) {
 
 bool WiFiClientSecure::loadCACert(Stream& stream, size_t size) {
   if (_CA_cert != NULL) free(const_cast<char*>(_CA_cert));
+  sslclient->parsed_ca_buff = NULL; // the new buffer may reuse the freed address
   char *dest = _streamLoad(stream, size);
   bool ret = false;
   if (dest) {
@@ -394,6 +621,7 @@ bool WiFiClientSecure::loadCACert(Stream& stream, size_t size) {
 
 bool WiFiClientSecure::loadCertificate(Stream& stream, size_t size) {
   if (_cert != NULL) free(const_cast<char*>(_cert));
+  sslclient->parsed_cert_buff = NULL; // the new buffer may reuse the freed address
   char *dest = _streamLoad(stream, size);
   bool ret = false;
   if (dest) {
@@ -405,6 +633,7 @@ bool WiFiClientSecure::loadCertificate(Stream& stream, size_t size) {
 
 bool WiFiClientSecure::loadPrivateKey(Stream& stream, size_t size) {
   if (_private_key != NULL) free(const_cast<char*>(_private_key));
+  sslclient->parsed_key_buff = NULL; // the new buffer may reuse the freed address
   char *dest = _streamLoad(stream, size);
   bool ret = false;
   if (dest) {
@@ -433,6 +662,27 @@ void WiFiClientSecure::setAlpnProtocols(const char **alpn_protos)
     _alpn_protos = alpn_protos;
 }
 
+void WiFiClientSecure::setSessionCache(bool enable)
+{
+    sslclient->use_session_cache = enable;
+    if (!enable) {
+        ssl_clear_session(sslclient);
+    }
+}
+
+void WiFiClientSecure::setCredentialCache(bool enable)
+{
+    sslclient->keep_credentials = enable;
+    if (!enable && !_connected) {
+        ssl_free_credentials(sslclient);
+    }
+}
+
+void WiFiClientSecure::clearSessionCache()
+{
+    ssl_clear_session(sslclient);
+}
+
 int WiFiClientSecure::fd() const
 {
     return sslclient->socket;
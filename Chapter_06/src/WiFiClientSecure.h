@@ -25,6 +25,18 @@
 #include <WiFi.h>
 #include "ssl_client.h"
 
+typedef enum {
+    TLS_CONNECT_FAILED = -1,
+    TLS_CONNECT_PENDING = 0,
+    TLS_CONNECT_READY = 1,
+} tls_connect_status_t;
+
+// One buffer of a scatter-gather write, see WiFiClientSecure::writev()
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+} tls_segment_t;
+
 class WiFiClientSecure : public WiFiClient
 {
 protected:
@@ -43,6 +55,16 @@ protected:
     const char **_alpn_protos;
     bool _use_ca_bundle;
 
+    enum { ASYNC_IDLE, ASYNC_CONNECTING, ASYNC_HANDSHAKING } _asyncState = ASYNC_IDLE;
+    unsigned long _asyncStartTime = 0;
+
+    uint8_t *_writeBuffer = NULL; // Staging for writev(), one record payload, allocated when a connection is up
+    size_t _writeBufferSize = 0;
+
+    bool setTimeoutOption(int option);
+    bool sendRecords(const uint8_t *buf, size_t size);
+    void allocateWriteBuffer();
+
 public:
     WiFiClientSecure *next;
     WiFiClientSecure();
@@ -57,12 +79,31 @@ public:
     int connect(IPAddress ip, uint16_t port, const char *pskIdent, const char *psKey);
     int connect(const char *host, uint16_t port, const char *pskIdent, const char *psKey);
     int connect(IPAddress ip, uint16_t port, const char *host, const char *CA_cert, const char *cert, const char *private_key);
+
+    // Non-blocking connect: connectAsync() opens the socket and returns immediately (only the
+    // DNS lookup of a host name can block), then poll() advances the TCP connect and the TLS
+    // handshake by one message per call until it reports TLS_CONNECT_READY or
+    // TLS_CONNECT_FAILED. Uses the credentials set with setCACert()/setCertificate()/
+    // setPrivateKey() or setPreSharedKey().
+    int connectAsync(IPAddress ip, uint16_t port, const char *host = NULL);
+    int connectAsync(const char *host, uint16_t port);
+    tls_connect_status_t poll();
+    bool connecting() { return _asyncState != ASYNC_IDLE; };
     int peek();
     size_t write(uint8_t data);
     size_t write(const uint8_t *buf, size_t size);
+
+    // Scatter-gather write: the segments go out as if they were one buffer, packed into as
+    // few TLS records as their total length allows, so a protocol header and its payload
+    // share one record and one MAC instead of costing a record each. mbedtls_ssl_write()
+    // takes one contiguous buffer per record, so bytes that do not fill a whole record are
+    // copied once into a staging buffer of one record payload; it is allocated when the
+    // connection comes up, never by writev(). Whole records are encrypted straight from the
+    // caller buffer. Returns the bytes written, less than the total after a failed write.
+    size_t writev(const tls_segment_t *segments, size_t count);
     int available();
     int read();
-    int read(uint8_t *buf, size_t size);
+    int read(uint8_t *buf, size_t size); // Decrypts straight into buf, -1 while no record is in
     void flush() {}
     void stop();
     uint8_t connected();
@@ -74,12 +115,31 @@ public:
     void setPrivateKey (const char *private_key);
     bool loadCACert(Stream& stream, size_t size);
     void setCACertBundle(const uint8_t * bundle);
+    void setCACertBundle(const uint8_t *bundle, size_t size);
+
+    // DER credentials, parsed in place (certificates zero-copy) instead of base64-decoding a
+    // PEM copy on every full handshake. The buffers must stay valid while the client is used.
+    void setCACertDER(const uint8_t *der, size_t length);
+    void setCertificateDER(const uint8_t *der, size_t length);
+    void setPrivateKeyDER(const uint8_t *der, size_t length);
+
+    // Ask the server for records of at most 512, 1024, 2048 or 4096 bytes (RFC 6066), 0 for
+    // the default 16 KB. Returns false for any other length.
+    bool setMaxFragmentLength(size_t length);
     bool loadCertificate(Stream& stream, size_t size);
     bool loadPrivateKey(Stream& stream, size_t size);
     bool verify(const char* fingerprint, const char* domain_name);
     void setHandshakeTimeout(unsigned long handshake_timeout);
     void setAlpnProtocols(const char **alpn_protos);
 
+    // Reconnect caches: resume the last TLS session (session ID or ticket) and keep
+    // the parsed CA/cert/key plus the seeded DRBG across stop()/connect().
+    void setSessionCache(bool enable);
+    void setCredentialCache(bool enable);
+    void clearSessionCache();
+    uint32_t getResumedHandshakes() { return sslclient->resumed_handshakes; };
+    uint32_t getFullHandshakes() { return sslclient->full_handshakes; };
+
     // Certain protocols start in plain-text; and then have the client
     // give some STARTSSL command to `upgrade' the connection to TLS
     // or SSL. Setting PlainStart to true (the default is false) enables
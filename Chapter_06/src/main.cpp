@@ -26,6 +26,7 @@
 #include <ArduinoJson.h> // For encoding and decoding JSON data
 #include <time.h> // Provides time functions, enabling NTP time synchronization
 #include <aws_certs.h> // Include the certificates and keys for AWS connections
+#include <esp_sleep.h> // Provides deep sleep with timer wake-up
 
 //********************************************************************************
 
@@ -50,6 +51,11 @@ const char* ntpServer = "pool.ntp.org"; // NTP server for time synchronization
 const long  gmtOffset_sec = -8 * 3600; // Offset for Pacific Time Zone (PST)
 const int   daylightOffset_sec = 0; // Daylight saving time offset
 
+// Duty cycle configuration, the chip deep sleeps between registrations
+const uint64_t REGISTRATION_INTERVAL_US = 4ULL * 60 * 60 * 1000000; // Sleep for 4 hours between registrations
+const unsigned long PUBLISH_FLUSH_MS = 500; // Time for the last MQTT packets to leave before the radio goes off
+RTC_DATA_ATTR uint32_t registrationCount = 0; // Registrations since power-on, kept in RTC memory during deep sleep
+
 // Initialize secure network client and MQTT client
 WiFiClientSecure net; // Secure network client for SSL/TLS connection
 PubSubClient client(net); // MQTT client using the secure network connection
@@ -86,11 +92,14 @@ void connectToAWS() {
     net.setCACert(aws_root_ca); // Load CA certificate
     net.setCertificate(aws_certificate); // Load client certificate
     net.setPrivateKey(aws_private_key); // Load client private key
+    net.setCredentialCache(true); // Keep the parsed certificates and key for reconnects
+    net.setSessionCache(true); // Resume the previous TLS session instead of a full handshake
     client.setServer(aws_endpoint, aws_port); // Configure MQTT client with AWS IoT endpoint and port
     while (!client.connected()) { // Try to connect to AWS IoT
         Serial.println("Connecting to AWS IoT..."); // Log attempting to connect
         if (client.connect("esp32")) { // Use a unique client ID for the connection
             Serial.println("Connected to AWS IoT"); // Log successful connection
+            Serial.printf("TLS handshakes: %u resumed, %u full\n", net.getResumedHandshakes(), net.getFullHandshakes()); // Log reconnect cost
         } else {
             Serial.print("Connection failed, rc="); // Log failed connection attempt
             Serial.println(client.state()); // Print the connection state
@@ -145,7 +154,16 @@ void loop() {
     client.loop(); // Process incoming messages and maintain MQTT connection
     publishMessage(); // Publish device registration message
     setLED(true); // Turn on the LED to indicate successful registration
-    delay(60000); // Keep the Wi-Fi connection alive for 1 minute
+    registrationCount++; // Count the registration across deep sleep
+    unsigned long flushStart = millis();
+    while (millis() - flushStart < PUBLISH_FLUSH_MS) { // Let the last packets leave
+        client.loop();
+        delay(10);
+    }
+    client.disconnect(); // Close the MQTT session cleanly
     WiFi.disconnect(true); // Disconnect from Wi-Fi
-    delay(4 * 60 * 60 * 1000); // Sleep for 4 hours before restarting the loop
+    Serial.printf("Registration %u done, awake for %lu ms, sleeping for 4 hours\n", registrationCount, millis()); // Log the wake-to-sleep time
+    Serial.flush(); // Send the log before the UART powers down
+    esp_sleep_enable_timer_wakeup(REGISTRATION_INTERVAL_US); // Wake up on the RTC timer
+    esp_deep_sleep_start(); // CPU and radio off, setup() runs again on wake-up
 }
@@ -14,6 +14,7 @@
 #include <lwip/netdb.h>
 #include <mbedtls/sha256.h>
 #include <mbedtls/oid.h>
+#include <mbedtls/version.h>
 #include <algorithm>
 #include <string>
 #include "ssl_client.h"
@@ -24,6 +25,10 @@
 #  warning "Please call `idf.py menuconfig` then go to Component config -> mbedTLS -> TLS Key Exchange Methods -> Enable pre-shared-key ciphersuites and then check `Enable PSK based cyphersuite modes`. Save and Quit."
 #else
 
+#ifndef MBEDTLS_PRIVATE
+#define MBEDTLS_PRIVATE(member) member // mbedtls 2.x exposes the session and context fields directly
+#endif
+
 const char *pers = "esp32-tls";
 
 static int _handle_error(int err, const char * function, int line)
@@ -51,18 +56,62 @@ void ssl_init(sslclient_context *ssl_client)
     mbedtls_ssl_init(&ssl_client->ssl_ctx);
     mbedtls_ssl_config_init(&ssl_client->ssl_conf);
     mbedtls_ctr_drbg_init(&ssl_client->drbg_ctx);
+    mbedtls_ssl_session_init(&ssl_client->saved_session);
 }
 
-int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_t port, const char* hostname, int timeout, const char *rootCABuff, bool useRootCABundle, const char *cli_cert, const char *cli_key, const char *pskIdent, const char *psKey, bool insecure, const char **alpn_protos)
+// Release the parsed CA/cert/key and the DRBG so the next connect parses and seeds again
+void ssl_free_credentials(sslclient_context *ssl_client)
 {
-    int ret;
-    int enable = 1;
-    log_v("Free internal heap before TLS %u", ESP.getFreeHeap());
+    mbedtls_x509_crt_free(&ssl_client->ca_cert);
+    mbedtls_x509_crt_free(&ssl_client->client_cert);
+    mbedtls_pk_free(&ssl_client->client_key);
+    ssl_client->parsed_ca_buff = NULL;
+    ssl_client->parsed_cert_buff = NULL;
+    ssl_client->parsed_key_buff = NULL;
+
+    if (ssl_client->drbg_seeded) {
+        mbedtls_ctr_drbg_free(&ssl_client->drbg_ctx);
+        mbedtls_entropy_free(&ssl_client->entropy_ctx);
+        mbedtls_ctr_drbg_init(&ssl_client->drbg_ctx);
+        ssl_client->drbg_seeded = false;
+    }
+}
 
-    if (rootCABuff == NULL && pskIdent == NULL && psKey == NULL && !insecure && !useRootCABundle) {
-        return -1;
+// Forget the cached session so the next connect does a full handshake
+void ssl_clear_session(sslclient_context *ssl_client)
+{
+    mbedtls_ssl_session_free(&ssl_client->saved_session);
+    mbedtls_ssl_session_init(&ssl_client->saved_session);
+    ssl_client->session_saved = false;
+}
+
+static void ssl_update_session_cache(sslclient_context *ssl_client)
+{
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+
+    bool have_session = ssl_client->use_session_cache && mbedtls_ssl_get_session(&ssl_client->ssl_ctx, &session) == 0;
+    if (ssl_client->session_resumed) {
+        ssl_client->resumed_handshakes++;
+        log_d("TLS session resumed (%u resumed, %u full)", ssl_client->resumed_handshakes, ssl_client->full_handshakes);
+    } else {
+        ssl_client->full_handshakes++;
+        log_d("Full TLS handshake (%u resumed, %u full)", ssl_client->resumed_handshakes, ssl_client->full_handshakes);
     }
 
+    if (have_session) {
+        // Hand ownership of the copied session (peer cert, ticket) over to the cache
+        mbedtls_ssl_session_free(&ssl_client->saved_session);
+        memcpy(&ssl_client->saved_session, &session, sizeof(session));
+        ssl_client->session_saved = true;
+    } else {
+        mbedtls_ssl_session_free(&session);
+    }
+}
+
+// Open a non-blocking socket and start the TCP connect without waiting for it to complete
+static int ssl_open_socket(sslclient_context *ssl_client, const IPAddress& ip, uint32_t port, int timeout)
+{
     log_v("Starting socket");
     ssl_client->socket = -1;
 
@@ -85,13 +134,6 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
 
     ssl_client->socket_timeout = timeout;
 
-    fd_set fdset;
-    struct timeval tv;
-    FD_ZERO(&fdset);
-    FD_SET(ssl_client->socket, &fdset);
-    tv.tv_sec = timeout / 1000;
-    tv.tv_usec = (timeout % 1000) * 1000;
-
     int res = lwip_connect(ssl_client->socket, (struct sockaddr*)&serv_addr, sizeof(serv_addr));
     if (res < 0 && errno != EINPROGRESS) {
         log_e("connect on fd %d, errno: %d, \"%s\"", ssl_client->socket, errno, strerror(errno));
@@ -99,18 +141,30 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
         ssl_client->socket = -1;
         return -1;
     }
+    return ssl_client->socket;
+}
 
-    res = select(ssl_client->socket + 1, nullptr, &fdset, nullptr, timeout<0 ? nullptr : &tv);
+// Wait up to timeout ms for the TCP connect started by ssl_open_socket(). Returns 1 once
+// the socket is connected and configured, 0 while the connect is still in progress and
+// -1 on error, in which case the socket has been closed.
+int ssl_poll_connect(sslclient_context *ssl_client, int timeout)
+{
+    int enable = 1;
+    fd_set fdset;
+    struct timeval tv;
+    FD_ZERO(&fdset);
+    FD_SET(ssl_client->socket, &fdset);
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+
+    int res = select(ssl_client->socket + 1, nullptr, &fdset, nullptr, timeout<0 ? nullptr : &tv);
     if (res < 0) {
         log_e("select on fd %d, errno: %d, \"%s\"", ssl_client->socket, errno, strerror(errno));
         lwip_close(ssl_client->socket);
         ssl_client->socket = -1;
         return -1;
     } else if (res == 0) {
-        log_i("select returned due to timeout %d ms for fd %d", timeout, ssl_client->socket);
-        lwip_close(ssl_client->socket);
-        ssl_client->socket = -1;
-        return -1;
+        return 0;
     } else {
         int sockerr;
         socklen_t len = (socklen_t)sizeof(int);
@@ -131,6 +185,9 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
         }
     }
 
+    // read/write timeouts use the full socket timeout, not what is left of the connect wait
+    tv.tv_sec = ssl_client->socket_timeout / 1000;
+    tv.tv_usec = (ssl_client->socket_timeout % 1000) * 1000;
 
 #define ROE(x,msg) { if (((x)<0)) { log_e("LWIP Socket config of " msg " failed."); return -1; }}
      ROE(lwip_setsockopt(ssl_client->socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)),"SO_RCVTIMEO");
@@ -139,15 +196,25 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
      ROE(lwip_setsockopt(ssl_client->socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)),"TCP_NODELAY");
      ROE(lwip_setsockopt(ssl_client->socket, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable)),"SO_KEEPALIVE");
 
+    return 1;
+}
 
+// Configure the TLS context for a socket opened by ssl_open_socket(). This does not touch
+// the network, so it can run before the TCP connect has completed.
+static int ssl_setup_context(sslclient_context *ssl_client, const IPAddress& ip, const char* hostname, const char *rootCABuff, bool useRootCABundle, const char *cli_cert, const char *cli_key, const char *pskIdent, const char *psKey, bool insecure, const char **alpn_protos)
+{
+    int ret;
 
-    log_v("Seeding the random number generator");
-    mbedtls_entropy_init(&ssl_client->entropy_ctx);
+    if (!ssl_client->drbg_seeded) {
+        log_v("Seeding the random number generator");
+        mbedtls_entropy_init(&ssl_client->entropy_ctx);
 
-    ret = mbedtls_ctr_drbg_seed(&ssl_client->drbg_ctx, mbedtls_entropy_func,
-                                &ssl_client->entropy_ctx, (const unsigned char *) pers, strlen(pers));
-    if (ret < 0) {
-        return handle_error(ret);
+        ret = mbedtls_ctr_drbg_seed(&ssl_client->drbg_ctx, mbedtls_entropy_func,
+                                    &ssl_client->entropy_ctx, (const unsigned char *) pers, strlen(pers));
+        if (ret < 0) {
+            return handle_error(ret);
+        }
+        ssl_client->drbg_seeded = true;
     }
 
     log_v("Setting up the SSL/TLS structure...");
@@ -159,6 +226,17 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
         return handle_error(ret);
     }
 
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    // Smaller records from the server; with variable buffer lengths enabled in the mbedTLS
+    // configuration the IN/OUT record buffers shrink to the negotiated size
+    if (ssl_client->max_frag_len != MBEDTLS_SSL_MAX_FRAG_LEN_NONE) {
+        log_v("Requesting max fragment length code %u", ssl_client->max_frag_len);
+        if ((ret = mbedtls_ssl_conf_max_frag_len(&ssl_client->ssl_conf, ssl_client->max_frag_len)) != 0) {
+            return handle_error(ret);
+        }
+    }
+#endif
+
     if (alpn_protos != NULL) {
         log_v("Setting ALPN protocols");
         if ((ret = mbedtls_ssl_conf_alpn_protocols(&ssl_client->ssl_conf, alpn_protos) ) != 0) {
@@ -173,17 +251,29 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
         mbedtls_ssl_conf_authmode(&ssl_client->ssl_conf, MBEDTLS_SSL_VERIFY_NONE);
         log_d("WARNING: Skipping SSL Verification. INSECURE!");
     } else if (rootCABuff != NULL) {
-        log_v("Loading CA cert");
-        mbedtls_x509_crt_init(&ssl_client->ca_cert);
         mbedtls_ssl_conf_authmode(&ssl_client->ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
-        ret = mbedtls_x509_crt_parse(&ssl_client->ca_cert, (const unsigned char *)rootCABuff, strlen(rootCABuff) + 1);
-        mbedtls_ssl_conf_ca_chain(&ssl_client->ssl_conf, &ssl_client->ca_cert, NULL);
-        //mbedtls_ssl_conf_verify(&ssl_client->ssl_ctx, my_verify, NULL );
-        if (ret < 0) {
-            // free the ca_cert in the case parse failed, otherwise, the old ca_cert still in the heap memory, that lead to "out of memory" crash.
+        if (ssl_client->parsed_ca_buff != rootCABuff) {
+            log_v("Loading CA cert");
             mbedtls_x509_crt_free(&ssl_client->ca_cert);
-            return handle_error(ret);
+            mbedtls_x509_crt_init(&ssl_client->ca_cert);
+            ssl_client->parsed_ca_buff = NULL;
+            if (ssl_client->ca_der_len != 0) {
+                // zero-copy: the parsed certificate points into the DER buffer in flash
+                ret = mbedtls_x509_crt_parse_der_nocopy(&ssl_client->ca_cert, (const unsigned char *)rootCABuff, ssl_client->ca_der_len);
+            } else {
+                ret = mbedtls_x509_crt_parse(&ssl_client->ca_cert, (const unsigned char *)rootCABuff, strlen(rootCABuff) + 1);
+            }
+            if (ret < 0) {
+                // free the ca_cert in the case parse failed, otherwise, the old ca_cert still in the heap memory, that lead to "out of memory" crash.
+                mbedtls_x509_crt_free(&ssl_client->ca_cert);
+                return handle_error(ret);
+            }
+            ssl_client->parsed_ca_buff = rootCABuff;
+        } else {
+            log_v("Reusing parsed CA cert");
         }
+        mbedtls_ssl_conf_ca_chain(&ssl_client->ssl_conf, &ssl_client->ca_cert, NULL);
+        //mbedtls_ssl_conf_verify(&ssl_client->ssl_ctx, my_verify, NULL );
     } else if (useRootCABundle) {
         log_v("Attaching root CA cert bundle");
         ret = esp_crt_bundle_attach(&ssl_client->ssl_conf);
@@ -229,27 +319,42 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
     // later during cleanup.
     
     if (!insecure && cli_cert != NULL && cli_key != NULL) {
-        mbedtls_x509_crt_init(&ssl_client->client_cert);
-        mbedtls_pk_init(&ssl_client->client_key);
-
-        log_v("Loading CRT cert");
-
-        ret = mbedtls_x509_crt_parse(&ssl_client->client_cert, (const unsigned char *)cli_cert, strlen(cli_cert) + 1);
-        if (ret < 0) {
-        // free the client_cert in the case parse failed, otherwise, the old client_cert still in the heap memory, that lead to "out of memory" crash.
-        mbedtls_x509_crt_free(&ssl_client->client_cert);
-            return handle_error(ret);
-        }
-
-        log_v("Loading private key");
-        mbedtls_ctr_drbg_context ctr_drbg;
-        mbedtls_ctr_drbg_init( &ctr_drbg );
-        ret = mbedtls_pk_parse_key(&ssl_client->client_key, (const unsigned char *)cli_key, strlen(cli_key) + 1, NULL, 0, mbedtls_ctr_drbg_random, &ctr_drbg);
-        mbedtls_ctr_drbg_free( &ctr_drbg );
-
-        if (ret != 0) {
-            mbedtls_x509_crt_free(&ssl_client->client_cert); // cert+key are free'd in pair
-            return handle_error(ret);
+        if (ssl_client->parsed_cert_buff != cli_cert || ssl_client->parsed_key_buff != cli_key) {
+            mbedtls_x509_crt_free(&ssl_client->client_cert);
+            mbedtls_pk_free(&ssl_client->client_key);
+            mbedtls_x509_crt_init(&ssl_client->client_cert);
+            mbedtls_pk_init(&ssl_client->client_key);
+            ssl_client->parsed_cert_buff = NULL;
+            ssl_client->parsed_key_buff = NULL;
+
+            log_v("Loading CRT cert");
+
+            if (ssl_client->cert_der_len != 0) {
+                ret = mbedtls_x509_crt_parse_der_nocopy(&ssl_client->client_cert, (const unsigned char *)cli_cert, ssl_client->cert_der_len);
+            } else {
+                ret = mbedtls_x509_crt_parse(&ssl_client->client_cert, (const unsigned char *)cli_cert, strlen(cli_cert) + 1);
+            }
+            if (ret < 0) {
+            // free the client_cert in the case parse failed, otherwise, the old client_cert still in the heap memory, that lead to "out of memory" crash.
+            mbedtls_x509_crt_free(&ssl_client->client_cert);
+                return handle_error(ret);
+            }
+
+            log_v("Loading private key");
+            mbedtls_ctr_drbg_context ctr_drbg;
+            mbedtls_ctr_drbg_init( &ctr_drbg );
+            size_t key_len = ssl_client->key_der_len != 0 ? ssl_client->key_der_len : strlen(cli_key) + 1; // DER skips the base64 decode
+            ret = mbedtls_pk_parse_key(&ssl_client->client_key, (const unsigned char *)cli_key, key_len, NULL, 0, mbedtls_ctr_drbg_random, &ctr_drbg);
+            mbedtls_ctr_drbg_free( &ctr_drbg );
+
+            if (ret != 0) {
+                mbedtls_x509_crt_free(&ssl_client->client_cert); // cert+key are free'd in pair
+                return handle_error(ret);
+            }
+            ssl_client->parsed_cert_buff = cli_cert;
+            ssl_client->parsed_key_buff = cli_key;
+        } else {
+            log_v("Reusing parsed client cert and private key");
         }
 
         mbedtls_ssl_conf_own_cert(&ssl_client->ssl_conf, &ssl_client->client_cert, &ssl_client->client_key);
@@ -268,26 +373,89 @@ int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_
         return handle_error(ret);
     }
 
+    ssl_client->session_resumed = false;
+    if (ssl_client->use_session_cache && ssl_client->session_saved) {
+        log_v("Offering cached TLS session");
+        if ((ret = mbedtls_ssl_set_session(&ssl_client->ssl_ctx, &ssl_client->saved_session)) != 0) {
+            log_w("Cached TLS session rejected (%d), doing a full handshake", ret);
+            ssl_clear_session(ssl_client);
+        }
+    }
+
     mbedtls_ssl_set_bio(&ssl_client->ssl_ctx, &ssl_client->socket, mbedtls_net_send, mbedtls_net_recv, NULL );
     return ssl_client->socket;
 }
 
-int ssl_starttls_handshake(sslclient_context *ssl_client)
+int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_t port, const char* hostname, int timeout, const char *rootCABuff, bool useRootCABundle, const char *cli_cert, const char *cli_key, const char *pskIdent, const char *psKey, bool insecure, const char **alpn_protos)
 {
-    char buf[512];
-    int ret, flags;
+    log_v("Free internal heap before TLS %u", ESP.getFreeHeap());
 
-    log_v("Performing the SSL/TLS handshake...");
-    unsigned long handshake_start_time=millis();
-    while ((ret = mbedtls_ssl_handshake(&ssl_client->ssl_ctx)) != 0) {
-        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
-            return handle_error(ret);
-        }
-        if((millis()-handshake_start_time)>ssl_client->handshake_timeout)
-            return -1;
-        vTaskDelay(2);//2 ticks
+    if (rootCABuff == NULL && pskIdent == NULL && psKey == NULL && !insecure && !useRootCABundle) {
+        return -1;
+    }
+
+    if (ssl_open_socket(ssl_client, ip, port, timeout) < 0) {
+        return -1;
+    }
+
+    int res = ssl_poll_connect(ssl_client, ssl_client->socket_timeout);
+    if (res == 0) {
+        log_i("select returned due to timeout %lu ms for fd %d", ssl_client->socket_timeout, ssl_client->socket);
+        lwip_close(ssl_client->socket);
+        ssl_client->socket = -1;
+        return -1;
+    } else if (res < 0) {
+        return -1;
+    }
+
+    return ssl_setup_context(ssl_client, ip, hostname, rootCABuff, useRootCABundle, cli_cert, cli_key, pskIdent, psKey, insecure, alpn_protos);
+}
+
+// Same as start_ssl_client() but returns as soon as the TCP connect is under way.
+// The caller drives the rest with ssl_poll_connect() and ssl_handshake_step().
+int start_ssl_client_async(sslclient_context *ssl_client, const IPAddress& ip, uint32_t port, const char* hostname, int timeout, const char *rootCABuff, bool useRootCABundle, const char *cli_cert, const char *cli_key, const char *pskIdent, const char *psKey, bool insecure, const char **alpn_protos)
+{
+    log_v("Free internal heap before TLS %u", ESP.getFreeHeap());
+
+    if (rootCABuff == NULL && pskIdent == NULL && psKey == NULL && !insecure && !useRootCABundle) {
+        return -1;
+    }
+
+    if (ssl_open_socket(ssl_client, ip, port, timeout) < 0) {
+        return -1;
     }
 
+    return ssl_setup_context(ssl_client, ip, hostname, rootCABuff, useRootCABundle, cli_cert, cli_key, pskIdent, psKey, insecure, alpn_protos);
+}
+
+static bool ssl_handshake_over(mbedtls_ssl_context *ssl)
+{
+#if MBEDTLS_VERSION_NUMBER >= 0x03020000
+    return mbedtls_ssl_is_handshake_over(ssl);
+#else
+    return ssl->state == MBEDTLS_SSL_HANDSHAKE_OVER;
+#endif
+}
+
+// Advance the handshake by one message and note whether the server accepted the offered
+// session: a resumed TLS 1.2 handshake goes from ServerHello straight to the server
+// ChangeCipherSpec, a full one on to the server Certificate and key exchange
+static int ssl_step_handshake(sslclient_context *ssl_client)
+{
+    mbedtls_ssl_context *ssl = &ssl_client->ssl_ctx;
+    bool at_server_hello = ssl->MBEDTLS_PRIVATE(state) == MBEDTLS_SSL_SERVER_HELLO;
+    int ret = mbedtls_ssl_handshake_step(ssl);
+    if (at_server_hello && ssl->MBEDTLS_PRIVATE(state) == MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC) {
+        ssl_client->session_resumed = true;
+    }
+    return ret;
+}
+
+// Verify the peer and release what the handshake no longer needs
+static int ssl_finish_handshake(sslclient_context *ssl_client)
+{
+    char buf[512];
+    int ret = 0, flags;
 
     if (ssl_client->client_cert.version) {
         log_d("Protocol is %s Ciphersuite is %s", mbedtls_ssl_get_version(&ssl_client->ssl_ctx), mbedtls_ssl_get_ciphersuite(&ssl_client->ssl_ctx));
@@ -308,25 +476,70 @@ int ssl_starttls_handshake(sslclient_context *ssl_client)
     } else {
         log_v("Certificate verified.");
     }
-    
-    if (ssl_client->ca_cert.version) {
-        mbedtls_x509_crt_free(&ssl_client->ca_cert);
-    }
 
-    // We know that we always have a client cert/key pair -- and we
-    // cannot look into the private client_key pk struct for newer
-    // versions of mbedtls. So rely on a public field of the cert
-    // and infer that there is a key too.
-    if (ssl_client->client_cert.version) {
-        mbedtls_x509_crt_free(&ssl_client->client_cert);
-        mbedtls_pk_free(&ssl_client->client_key);
-    }    
+    ssl_update_session_cache(ssl_client);
+
+    if (!ssl_client->keep_credentials) {
+        if (ssl_client->ca_cert.version) {
+            mbedtls_x509_crt_free(&ssl_client->ca_cert);
+            ssl_client->parsed_ca_buff = NULL;
+        }
+
+        // We know that we always have a client cert/key pair -- and we
+        // cannot look into the private client_key pk struct for newer
+        // versions of mbedtls. So rely on a public field of the cert
+        // and infer that there is a key too.
+        if (ssl_client->client_cert.version) {
+            mbedtls_x509_crt_free(&ssl_client->client_cert);
+            mbedtls_pk_free(&ssl_client->client_key);
+            ssl_client->parsed_cert_buff = NULL;
+            ssl_client->parsed_key_buff = NULL;
+        }
+    }
 
     log_v("Free internal heap after TLS %u", ESP.getFreeHeap());
 
     return ssl_client->socket;
 }
 
+int ssl_starttls_handshake(sslclient_context *ssl_client)
+{
+    int ret;
+
+    log_v("Performing the SSL/TLS handshake...");
+    unsigned long handshake_start_time=millis();
+    while (!ssl_handshake_over(&ssl_client->ssl_ctx)) {
+        if ((ret = ssl_step_handshake(ssl_client)) == 0) {
+            continue;
+        }
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return handle_error(ret);
+        }
+        if((millis()-handshake_start_time)>ssl_client->handshake_timeout)
+            return -1;
+        vTaskDelay(2);//2 ticks
+    }
+
+    return ssl_finish_handshake(ssl_client);
+}
+
+// Advance the handshake by a single message without blocking. Returns 1 once the handshake
+// is complete and the peer verified, 0 while it is still in progress and <0 on error.
+// The caller owns the handshake timeout.
+int ssl_handshake_step(sslclient_context *ssl_client)
+{
+    int ret = ssl_step_handshake(ssl_client);
+    if (ret != 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return handle_error(ret);
+    }
+    if (!ssl_handshake_over(&ssl_client->ssl_ctx)) {
+        return 0;
+    }
+
+    ret = ssl_finish_handshake(ssl_client);
+    return ret < 0 ? ret : 1;
+}
+
 void stop_ssl_socket(sslclient_context *ssl_client, const char *rootCABuff, const char *cli_cert, const char *cli_key)
 {
     log_v("Cleaning SSL connection.");
@@ -336,28 +549,17 @@ void stop_ssl_socket(sslclient_context *ssl_client, const char *rootCABuff, cons
         ssl_client->socket = -1;
     }
 
-    // avoid memory leak if ssl connection attempt failed
-    // if (ssl_client->ssl_conf.ca_chain != NULL) {
-        mbedtls_x509_crt_free(&ssl_client->ca_cert);
-    // }
-    // if (ssl_client->ssl_conf.key_cert != NULL) {
-        mbedtls_x509_crt_free(&ssl_client->client_cert);
-        mbedtls_pk_free(&ssl_client->client_key);
-    // }
+    // avoid memory leak if ssl connection attempt failed; with the credential
+    // cache enabled the parsed certs, key and DRBG survive for the next connect
+    if (!ssl_client->keep_credentials) {
+        ssl_free_credentials(ssl_client);
+    }
     mbedtls_ssl_free(&ssl_client->ssl_ctx);
     mbedtls_ssl_config_free(&ssl_client->ssl_conf);
-    mbedtls_ctr_drbg_free(&ssl_client->drbg_ctx);
-    mbedtls_entropy_free(&ssl_client->entropy_ctx);
-    
-    // save only interesting fields
-    int handshake_timeout = ssl_client->handshake_timeout;
-    int socket_timeout = ssl_client->socket_timeout;
 
-    // reset embedded pointers to zero
-    memset(ssl_client, 0, sizeof(sslclient_context));
-    
-    ssl_client->handshake_timeout = handshake_timeout;
-    ssl_client->socket_timeout = socket_timeout;
+    // the per-connection contexts are reused by the next start_ssl_client()
+    mbedtls_ssl_init(&ssl_client->ssl_ctx);
+    mbedtls_ssl_config_init(&ssl_client->ssl_conf);
 }
 
 
@@ -398,6 +600,13 @@ int send_ssl_data(sslclient_context *ssl_client, const uint8_t *data, size_t len
     return ret;
 }
 
+// Largest plaintext one mbedtls_ssl_write() puts into a single record, after the max
+// fragment length negotiation and the output buffer size; negative on error
+int get_ssl_max_out_payload(sslclient_context *ssl_client)
+{
+    return mbedtls_ssl_get_max_out_record_payload(&ssl_client->ssl_ctx);
+}
+
 // Some protocols, such as SMTP, XMPP, MySQL/Posgress and various others
 // do a 'in-line' upgrade from plaintext to SSL or TLS (usually with some
 // sort of 'STARTTLS' textual command from client to sever). For this
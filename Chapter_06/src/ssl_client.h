@@ -26,15 +26,43 @@ typedef struct sslclient_context {
 
     unsigned long socket_timeout;
     unsigned long handshake_timeout;
+
+    // Reconnect caches, kept across stop_ssl_socket() when enabled
+    bool keep_credentials;          // keep the parsed CA/cert/key and the seeded DRBG
+    bool drbg_seeded;
+    const char *parsed_ca_buff;     // buffers the parsed credentials above came from
+    const char *parsed_cert_buff;
+    const char *parsed_key_buff;
+
+    // DER credentials, parsed in place from flash instead of decoding a PEM copy on the heap
+    size_t ca_der_len;              // length of the DER CA certificate, 0 for a PEM string
+    size_t cert_der_len;            // length of the DER client certificate, 0 for a PEM string
+    size_t key_der_len;             // length of the DER private key, 0 for a PEM string
+
+    unsigned char max_frag_len;     // MBEDTLS_SSL_MAX_FRAG_LEN_* asked for in the ClientHello
+
+    bool use_session_cache;         // offer the last session (ID or ticket) on reconnect
+    bool session_saved;
+    mbedtls_ssl_session saved_session;
+    bool session_resumed;           // the server accepted the offered session in this handshake
+
+    uint32_t resumed_handshakes;
+    uint32_t full_handshakes;
 } sslclient_context;
 
 
 void ssl_init(sslclient_context *ssl_client);
 int start_ssl_client(sslclient_context *ssl_client, const IPAddress& ip, uint32_t port, const char* hostname, int timeout, const char *rootCABuff, bool useRootCABundle, const char *cli_cert, const char *cli_key, const char *pskIdent, const char *psKey, bool insecure, const char **alpn_protos);
 int ssl_starttls_handshake(sslclient_context *ssl_client);
+int start_ssl_client_async(sslclient_context *ssl_client, const IPAddress& ip, uint32_t port, const char* hostname, int timeout, const char *rootCABuff, bool useRootCABundle, const char *cli_cert, const char *cli_key, const char *pskIdent, const char *psKey, bool insecure, const char **alpn_protos);
+int ssl_poll_connect(sslclient_context *ssl_client, int timeout);
+int ssl_handshake_step(sslclient_context *ssl_client);
 void stop_ssl_socket(sslclient_context *ssl_client, const char *rootCABuff, const char *cli_cert, const char *cli_key);
+void ssl_free_credentials(sslclient_context *ssl_client);
+void ssl_clear_session(sslclient_context *ssl_client);
 int data_to_read(sslclient_context *ssl_client);
 int send_ssl_data(sslclient_context *ssl_client, const uint8_t *data, size_t len);
+int get_ssl_max_out_payload(sslclient_context *ssl_client);
 int get_ssl_receive(sslclient_context *ssl_client, uint8_t *data, int length);
 int send_net_data(sslclient_context *ssl_client, const uint8_t *data, size_t len);
 int get_net_receive(sslclient_context *ssl_client, uint8_t *data, int length);
@@ -17,6 +17,8 @@
 // Libraries Import
 // **********************************
 #include <Arduino.h>
+#include "SamplingEngine.h"   // Adaptive sampling and report-by-exception, shared from Chapter_08/lib
+#include "UltrasonicRanger.h" // RMT timed HC-SR04 ranging, shared from Chapter_08/lib
 
 // **********************************
 // Constants and Variables Declaration
@@ -52,8 +54,17 @@ unsigned long lastCheckTime = 0;                     // Last time the sensor was
 constexpr float CLOSE_RANGE = 10.0;
 constexpr float MID_RANGE = 30.0;
 
-// Speed of sound constant (cm/µs) / 2
-constexpr float SOUND_SPEED_CM_PER_US = 0.017;
+// Continuous ranging, the RMT peripheral times the echo while the loop keeps running
+constexpr uint32_t RANGING_PERIOD_MS = 40; // 25 Hz, leaves the previous echo time to fade
+UltrasonicRanger ranger(TRIG_PIN, ECHO_PIN);
+
+// Adaptive sampling, fast near CLOSE_RANGE/MID_RANGE and while an object moves
+constexpr unsigned long SENSOR_FAST_READ_INTERVAL = 100;   // Read interval near a range boundary or during movement
+constexpr unsigned long SENSOR_HEARTBEAT_INTERVAL = 10000; // Longest time between two status reports
+constexpr SamplingChannelConfig DISTANCE_SAMPLING_CHANNELS[] = {
+    {1.0, 20.0, CLOSE_RANGE, MID_RANGE, 5.0}, // 1 cm deadband, fast within 5 cm of a range boundary or above 20 cm/s
+};
+SamplingEngine<1> distanceSampling(DISTANCE_SAMPLING_CHANNELS, {SENSOR_READ_INTERVAL, SENSOR_FAST_READ_INTERVAL, SENSOR_HEARTBEAT_INTERVAL});
 
 int lastRedState = 0; 
 int lastGreenState = 0;
@@ -64,7 +75,6 @@ bool isBuzzerOn = false; // Track whether the buzzer should be considered ON or
 // **********************************
 // Funcion Declaration
 // **********************************
-void readUltrasoundSensor(float &distance); // Function to measure distance using HC-SR04
 void updateIndicatorStatus(float distance); // Function to update LED indicators based on the distance
 void beepBuzzerAlert(bool active);          // Function to control buzzer activity
 void setLEDState(bool red, bool green, bool blue);
@@ -74,8 +84,9 @@ void setLEDState(bool red, bool green, bool blue);
 // **********************************
 void setup() {
     Serial.begin(115200);
-    pinMode(TRIG_PIN, OUTPUT);
-    pinMode(ECHO_PIN, INPUT);
+    if (!ranger.begin()) // The RMT driver owns TRIG_PIN and ECHO_PIN
+        Serial.println("Error: RMT ranging setup failed");
+    ranger.startContinuous(RANGING_PERIOD_MS);
     pinMode(LED_RED_PIN, OUTPUT);
     pinMode(LED_GREEN_PIN, OUTPUT);
     pinMode(LED_BLUE_PIN, OUTPUT);
@@ -98,11 +109,25 @@ void setup() {
 // Main Loop
 // **********************************
 void loop() {
-    if (millis() - lastCheckTime >= SENSOR_READ_INTERVAL) {
+    ranger.update(); // Start the next trigger or pick up a finished echo, never waits
+
+    if (millis() - lastCheckTime >= distanceSampling.intervalMs()) {
         lastCheckTime = millis();
-        float currentDistance = 0.0;
-        readUltrasoundSensor(currentDistance);
-        updateIndicatorStatus(currentDistance);
+        float currentDistance = ranger.distanceCm(); // Median and EMA filtered, NAN without a valid echo
+        float values[] = {currentDistance};
+        if (distanceSampling.update(values, lastCheckTime)) { // Only act on a change, a range crossing or the heartbeat
+            if (isnan(currentDistance)) {
+                Serial.println("Distance: out of range");
+            } else {
+                Serial.print("Distance: ");
+                Serial.print(currentDistance);
+                Serial.println(" cm");
+            }
+            Serial.print("Invalid echoes: ");
+            Serial.print(ranger.takeInvalidRate() * 100.0f);
+            Serial.println(" %");
+            updateIndicatorStatus(currentDistance);
+        }
     }
 }
 
@@ -110,23 +135,6 @@ void loop() {
 // Function Definitions
 // **********************************
 
-void readUltrasoundSensor(float &distance) {
-    digitalWrite(TRIG_PIN, LOW);
-    delayMicroseconds(2);
-    digitalWrite(TRIG_PIN, HIGH);
-    delayMicroseconds(10);
-    digitalWrite(TRIG_PIN, LOW);
-    long duration = pulseIn(ECHO_PIN, HIGH, 30000);
-    if (duration > 0) {
-        distance = duration * SOUND_SPEED_CM_PER_US;
-        Serial.print("Distance: ");
-        Serial.print(distance);
-        Serial.println(" cm");
-    } else {
-        Serial.println("Error: No echo received");
-    }
-}
-
 void updateIndicatorStatus(float distance) {
     bool currentRedState = (distance < CLOSE_RANGE);
     bool currentGreenState = (distance > MID_RANGE);
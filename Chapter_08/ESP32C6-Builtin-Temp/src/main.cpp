@@ -7,6 +7,8 @@
 // Code Purpose:
 // This code snippet is designed to measure the temperature using the ESP32-C6's built-in temperature sensor
 // and visually indicate the temperature range using the built-in RGB LED.
+// With TEMP_SENSOR_EVENT_MODE=1 the sensor's threshold interrupt wakes the loop on a range change,
+// and the loop only reads on its own every TEMP_SENSOR_HEARTBEAT_MS.
 //
 // Requirement:
 // 1. Use the ESP32-C6's built-in RGB LED for temperature range indication.
@@ -28,79 +30,169 @@
 #include <ESP32Info.h>                  // Library for accessing ESP32-C6 hardware information
 #include "builtin_temperature_sensor.h" // Library for accessing the ESP32-C6's built-in temperature sensor
 #include <Adafruit_NeoPixel.h>          // Library for controlling RGB LEDs, the built-in one on ESP32-C6
-#include <map>                          // Includes the map library for mapping alert types to their corresponding configurations.
+#include <esp_arduino_version.h>        // Arduino core version, the LEDC API changed in 3.0
+#include <esp_timer.h>                  // High resolution timer stepping through the alert tones
+#include <atomic>                       // Atomic hand-over of a new alert to the timer task
+#include "IndicatorEngine.h"            // Library for playing LED and buzzer patterns from a timer
 
 // Define constants for LED and buzzer control
 #define LED_PIN 8     // Pin number for the NeoPixel LED
 #define STRIP_COUNT 1 // Number of LEDs in the strip (1 for built-in)
 #define BUZZER_PIN 4  // Pin number for the buzzer
+#define BUZZER_CHANNEL 0     // LEDC channel for the buzzer (Arduino core 2.x)
+#define BUZZER_RESOLUTION 10 // LEDC duty resolution for the buzzer
+
+// Threshold interrupt mode, set TEMP_SENSOR_EVENT_MODE=1 in build_flags to read only on a threshold crossing
+#ifndef TEMP_SENSOR_EVENT_MODE
+#define TEMP_SENSOR_EVENT_MODE 0 // 0 polls the sensor every readInterval
+#endif
+#ifndef TEMP_SENSOR_HEARTBEAT_MS
+#define TEMP_SENSOR_HEARTBEAT_MS 60000 // Reading interval without a crossing in event mode, 0 disables the heartbeat
+#endif
 
 // Global variables for temperature reading and LED blinking control
-int pixelIndex = 0;                // Index for the controlled LED (only one in this case)
-unsigned long readInterval = 5000; // Interval between temperature readings (milliseconds)
-unsigned long lastReadTime = 0;    // Timestamp of the last temperature reading
-unsigned long blinkInterval = 500; // Blink interval for the LED (milliseconds)
-unsigned long lastBlinkTime = 0;   // Timestamp of the last LED blink
-bool ledBlinkState = false;        // Current state of LED blinking (on or off)
+int pixelIndex = 0;                     // Index for the controlled LED (only one in this case)
+unsigned long readInterval = 5000;      // Interval between temperature readings (milliseconds)
+unsigned long lastReadTime = 0;         // Timestamp of the last temperature reading
+constexpr uint16_t blinkInterval = 500; // Blink interval for the LED (milliseconds)
 
 // Temperature thresholds for indicating different states
 float lowTempThreshold = 15.0;  // Threshold for low temperature
 float highTempThreshold = 25.0; // Threshold for high temperature
 
-class BuzzerController {
-private:
-    int buzzerPin; // Pin attached to the buzzer
+// One tone of an alert, a frequency of 0 is a pause
+struct BuzzerTone {
+    uint16_t frequency;  // Tone frequency (Hz)
+    uint16_t durationMs; // Tone length (milliseconds)
+};
 
-    // Structure for buzzer configuration (frequency and duration)
-    struct BuzzerAlertConfig {
-        int frequency;
-        int duration;
-    };
+constexpr uint8_t BUZZER_MAX_TONES = 6; // Longest alert
+
+// Structure for buzzer configuration, a sequence of tones played once
+struct BuzzerAlertConfig {
+    uint8_t toneCount;                  // Tones in use
+    BuzzerTone tones[BUZZER_MAX_TONES]; // Tones in play order
+};
 
+// Plays the alerts through LEDC, stepping from one tone to the next in a one-shot esp_timer.
+// beep() only hands the alert over and returns, the table is constant and nothing is allocated.
+class BuzzerController {
 public:
     enum AlertType {
         ALERT_MUTE,   // No sound
         ALERT_LOW,    // Low temperature alert
         ALERT_MEDIUM, // Medium temperature alert
         ALERT_HIGH,   // High temperature alert
-        ALERT_ERROR   // Sensor error alert
+        ALERT_ERROR,  // Sensor error alert
+        ALERT_COUNT   // Number of alert types, not an alert
     };
 
-    std::map<AlertType, BuzzerAlertConfig> alertConfigs; // Maps alert types to configurations
-
-    // Constructor initializes the buzzer pin and default configurations
-    BuzzerController(int pin) : buzzerPin(pin) {
-        pinMode(buzzerPin, OUTPUT); // Set the buzzer pin as an output
+    // Alert configurations indexed by AlertType
+    static constexpr BuzzerAlertConfig alertConfigs[ALERT_COUNT] = {
+        {0, {}},                                                       // ALERT_MUTE
+        {3, {{1000, 100}, {0, 100}, {1000, 100}}},                     // ALERT_LOW: two short beeps
+        {1, {{2000, 200}}},                                            // ALERT_MEDIUM: one beep
+        {3, {{2500, 100}, {3000, 100}, {3500, 100}}},                  // ALERT_HIGH: rising chirp
+        {5, {{250, 300}, {0, 100}, {250, 300}, {0, 100}, {250, 300}}}, // ALERT_ERROR: three long low beeps
+    };
 
-        // Initialize default configurations for each alert type
-        alertConfigs[ALERT_MUTE] = {0, 0};
-        alertConfigs[ALERT_LOW] = {1000, 100};
-        alertConfigs[ALERT_MEDIUM] = {2000, 200};
-        alertConfigs[ALERT_HIGH] = {3000, 300};
-        alertConfigs[ALERT_ERROR] = {250, 1000};
+    // Constructor only stores the pin, the hardware is set up in begin()
+    BuzzerController(int pin) : buzzerPin(pin) {}
+
+    // Attaches the buzzer to LEDC and creates the tone timer, returns false on failure
+    bool begin() {
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+        if (!ledcAttach(buzzerPin, alertConfigs[ALERT_MEDIUM].tones[0].frequency, BUZZER_RESOLUTION))
+            return false;
+#else
+        ledcSetup(BUZZER_CHANNEL, alertConfigs[ALERT_MEDIUM].tones[0].frequency, BUZZER_RESOLUTION);
+        ledcAttachPin(buzzerPin, BUZZER_CHANNEL);
+#endif
+        writeTone(0); // Silent until the first alert
+
+        esp_timer_create_args_t args = {};
+        args.callback = onTimer;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "buzzer";
+        return esp_timer_create(&args, &timer) == ESP_OK;
     }
 
-    // Plays a beep sound based on the specified alert type
+    // Plays a beep sound based on the specified alert type, replacing the alert being played
     void beep(AlertType type) {
-        if (type == ALERT_MUTE || alertConfigs.find(type) == alertConfigs.end()) {
-            noTone(buzzerPin); // Stop any ongoing tone
-        } else {
-            BuzzerAlertConfig config = alertConfigs[type];
-            tone(buzzerPin, config.frequency, config.duration);
-        }
+        if (timer == nullptr || type >= ALERT_COUNT)
+            return;
+        pendingAlert.store(type);
+        beepRequests.store(beepRequests.load() + 1); // Only beep() writes it, no read-modify-write needed
+        esp_timer_stop(timer);          // Cancel the rest of the old alert
+        esp_timer_start_once(timer, 0); // First tone right away
     }
 
     // Stops any ongoing tone, effectively muting the buzzer
     void mute() {
-        noTone(buzzerPin);
+        beep(ALERT_MUTE);
+    }
+
+private:
+    int buzzerPin;                                   // Pin attached to the buzzer
+    esp_timer_handle_t timer = nullptr;              // One-shot timer of the next tone
+    std::atomic<AlertType> pendingAlert{ALERT_MUTE}; // Alert handed over by beep()
+    std::atomic<uint32_t> beepRequests{0};           // Calls of beep(), written after pendingAlert
+    uint32_t handledRequests = 0;                    // beepRequests at the last restart, timer task only
+    AlertType playingAlert = ALERT_MUTE;             // Alert being played, timer task only
+    uint8_t nextTone = 0;                            // Next tone of playingAlert, timer task only
+
+    void writeTone(uint16_t frequency) {
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+        ledcWriteTone(buzzerPin, frequency); // 0 Hz sets the duty to 0
+#else
+        ledcWriteTone(BUZZER_CHANNEL, frequency);
+#endif
+    }
+
+    static void onTimer(void *arg) {
+        BuzzerController *self = static_cast<BuzzerController *>(arg);
+        uint32_t requests = self->beepRequests.load();
+        if (requests != self->handledRequests) { // A new alert, start it from the first tone
+            self->handledRequests = requests;
+            self->playingAlert = self->pendingAlert.load();
+            self->nextTone = 0;
+        }
+
+        const BuzzerAlertConfig &config = alertConfigs[self->playingAlert];
+        if (self->nextTone >= config.toneCount) {
+            self->writeTone(0); // Alert finished
+            return;
+        }
+        const BuzzerTone &tone = config.tones[self->nextTone++];
+        self->writeTone(tone.frequency);
+        esp_timer_start_once(self->timer, (uint64_t)tone.durationMs * 1000);
     }
 };
 
+constexpr BuzzerAlertConfig BuzzerController::alertConfigs[]; // Storage of the table, needed before C++17
+
+// Bits of an indicator pattern step, the color bits mix into the color of the LED
+constexpr uint8_t INDICATOR_RED = 1 << 0;    // Red component on
+constexpr uint8_t INDICATOR_GREEN = 1 << 1;  // Green component on
+constexpr uint8_t INDICATOR_BLUE = 1 << 2;   // Blue component on
+constexpr uint8_t INDICATOR_BUZZER = 1 << 3; // High temperature beep on
+
+// Indicator patterns, declared once and played by the esp_timer of the indicator engine
+constexpr IndicatorPattern NORMAL_PATTERN = {1, {{INDICATOR_GREEN, 0}}}; // Steady green
+constexpr IndicatorPattern LOW_PATTERN = {1, {{INDICATOR_BLUE, 0}}};     // Steady blue
+constexpr IndicatorPattern ERROR_PATTERN = {1, {{INDICATOR_RED, 0}}};    // Steady red
+constexpr IndicatorPattern HIGH_PATTERN = {2, {
+    {INDICATOR_RED | INDICATOR_BUZZER, blinkInterval}, // Red with a beep
+    {0, blinkInterval},                                // Off
+}};
+
+// Drives the NeoPixel and the buzzer for the indicator engine
 class LEDController {
 private:
-    Adafruit_NeoPixel strip;         // NeoPixel strip object
-    bool ledState = false;           // Current LED state (on/off) for blinking
-    unsigned long lastBlinkTime = 0; // Timestamp of the last blink action
+    Adafruit_NeoPixel strip;  // NeoPixel strip object, sent out by the RMT peripheral
+    BuzzerController &buzzer; // Buzzer beeping with the blinks
+    uint8_t shownOutputs = 0; // Pattern bits currently on the LED and the buzzer
 
 public:
     enum class Colors {
@@ -129,7 +221,7 @@ public:
     Colors currentLEDColor = Colors::Off;
 
     // Constructor initializes the NeoPixel strip
-    LEDController(uint8_t pin, uint8_t count) : strip(Adafruit_NeoPixel(count, pin, NEO_GRB + NEO_KHZ800)) {}
+    LEDController(uint8_t pin, uint8_t count, BuzzerController &buzzer) : strip(Adafruit_NeoPixel(count, pin, NEO_GRB + NEO_KHZ800)), buzzer(buzzer) {}
 
     // Initializes the LED strip
     void begin() {
@@ -137,42 +229,54 @@ public:
         strip.show(); // Turn off the LED initially
     }
 
-    // Sets the LED color
-    void setColor(Colors color) {
-        currentLEDColor = color; // Update the current LED color
-        strip.fill(static_cast<uint32_t>(color), 0, STRIP_COUNT); // Set the color on the strip
-        strip.show(); // Apply the color change
-    }
-
-    // Handles the blinking logic for the LED based on the specified color
-    void handleBlink(Colors blinkColor, unsigned long currentMillis, BuzzerController &buzzer) {
-        // Only proceed if blinking is necessary (currentColor matches blinkColor or ledState is true)
-        if (currentLEDColor != blinkColor && !ledState) return;
-
-        if (currentMillis - lastBlinkTime >= blinkInterval) { // Check if it's time to toggle the blink state
-            lastBlinkTime = currentMillis; // Update the last blink time
-            ledState = !ledState; // Toggle the LED state
-
-            // Set the LED color based on the current blink state
-            strip.show();
-            strip.fill(ledState ? static_cast<uint32_t>(blinkColor) : static_cast<uint32_t>(Colors::Off), 0, STRIP_COUNT);
-            strip.show();
-            
-            // Control the buzzer based on the LED state
-            if (ledState) {
+    // Shows one pattern step, called from the esp_timer task of the indicator engine.
+    // The strip is sent once per color change. The buzzer follows the changes of its bit within
+    // a pattern; a new pattern (force) never mutes it, so the alert of the new state plays out
+    void write(uint8_t outputs, bool force) {
+        uint8_t colorBits = INDICATOR_RED | INDICATOR_GREEN | INDICATOR_BLUE;
+        if (force || ((outputs ^ shownOutputs) & colorBits)) {
+            uint32_t color = 0;
+            if (outputs & INDICATOR_RED) color |= static_cast<uint32_t>(Colors::Red);
+            if (outputs & INDICATOR_GREEN) color |= static_cast<uint32_t>(Colors::Green);
+            if (outputs & INDICATOR_BLUE) color |= static_cast<uint32_t>(Colors::Blue);
+            currentLEDColor = static_cast<Colors>(color); // Update the current LED color
+            strip.fill(color, 0, STRIP_COUNT); // Set the color on the strip
+            strip.show(); // Apply the color change
+        }
+        if ((force ? outputs : outputs ^ shownOutputs) & INDICATOR_BUZZER) {
+            if (outputs & INDICATOR_BUZZER) {
                 buzzer.beep(BuzzerController::ALERT_HIGH); // Beep when the LED is on
             } else {
                 buzzer.mute(); // Mute the buzzer when the LED is off
             }
         }
+        shownOutputs = outputs;
     }
 };
 
 class TemperatureSensor {
 private:
-    temperature_sensor_handle_t tsens; // Handle for the temperature sensor
-    float lowThreshold;                // Low temperature threshold
-    float highThreshold;               // High temperature threshold
+    static constexpr int RANGE_MIN = -10;                     // Lowest temperature of the measurement range
+    static constexpr int RANGE_MAX = 80;                      // Highest temperature of the measurement range
+    static constexpr float THRESHOLD_HYSTERESIS = 1.0;        // Margin a temperature must move back before a state ends
+    static constexpr unsigned long ERROR_COOLDOWN_MS = 60000; // Time without reads after a sensor error
+
+    temperature_sensor_handle_t tsens = nullptr;              // Handle for the temperature sensor
+    float lowThreshold;                                       // Low temperature threshold
+    float highThreshold;                                      // High temperature threshold
+    SemaphoreHandle_t thresholdSemaphore = nullptr;           // Given by the threshold interrupt, nullptr in polling mode
+    bool inCooldown = false;                                  // A read failed less than ERROR_COOLDOWN_MS ago
+    unsigned long lastErrorTime = 0;                          // Timestamp of the last sensor error
+
+#if SOC_TEMPERATURE_SENSOR_INTR_SUPPORT
+    // Threshold interrupt, only wakes the loop, reading and re-arming happen there
+    static bool IRAM_ATTR onThreshold(temperature_sensor_handle_t, const temperature_sensor_threshold_event_data_t *, void *arg) {
+        TemperatureSensor *self = static_cast<TemperatureSensor *>(arg);
+        BaseType_t taskWoken = pdFALSE;
+        xSemaphoreGiveFromISR(self->thresholdSemaphore, &taskWoken);
+        return taskWoken == pdTRUE; // Yield to the loop on return from the interrupt
+    }
+#endif
 
 public:
     enum TemperatureState {
@@ -182,34 +286,93 @@ public:
         Error
     };
 
-    // Constructor with custom temperature thresholds
+    // Constructor with custom temperature thresholds, the sensor is set up in begin()
     TemperatureSensor(float lowThreshold, float highThreshold)
-        : lowThreshold(lowThreshold), highThreshold(highThreshold) {
-        temperature_sensor_config_t tsens_config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-10, 80);
+        : lowThreshold(lowThreshold), highThreshold(highThreshold) {}
+
+    // Installs and enables the sensor; with thresholdEvents the threshold interrupt wakes
+    // waitForThreshold(), otherwise the sensor is only polled. Returns false if the sensor failed
+    bool begin(bool thresholdEvents) {
+        temperature_sensor_config_t tsens_config = TEMPERATURE_SENSOR_CONFIG_DEFAULT(RANGE_MIN, RANGE_MAX);
         esp_err_t result = temperature_sensor_install(&tsens_config, &tsens);
+        if (result != ESP_OK) {
+            Serial.println("Failed to initialize temperature sensor. Check hardware connections.");
+            return false;
+        }
 
-        if (result == ESP_OK) {
-            result = temperature_sensor_enable(tsens);
-            if (result != ESP_OK) {
-                Serial.println("Failed to enable temperature sensor. Check hardware connections.");
+#if SOC_TEMPERATURE_SENSOR_INTR_SUPPORT
+        if (thresholdEvents) { // The callbacks can only be registered before the sensor is enabled
+            thresholdSemaphore = xSemaphoreCreateBinary();
+            temperature_sensor_event_callbacks_t callbacks = {};
+            callbacks.on_threshold = onThreshold;
+            if (thresholdSemaphore == nullptr || temperature_sensor_register_callbacks(tsens, &callbacks, this) != ESP_OK) {
+                Serial.println("Failed to register the threshold interrupt, polling the sensor instead.");
+                if (thresholdSemaphore != nullptr)
+                    vSemaphoreDelete(thresholdSemaphore);
+                thresholdSemaphore = nullptr;
             }
-        } else {
-            Serial.println("Failed to initialize temperature sensor. Check hardware connections.");
         }
+#else
+        if (thresholdEvents)
+            Serial.println("No threshold interrupt on this chip, polling the sensor instead.");
+#endif
+
+        result = temperature_sensor_enable(tsens);
+        if (result != ESP_OK) {
+            Serial.println("Failed to enable temperature sensor. Check hardware connections.");
+            return false;
+        }
+        armThresholds(Normal); // Any temperature outside the normal range wakes the loop at once
+        return true;
+    }
+
+    // True when the threshold interrupt is in use
+    bool thresholdEventsEnabled() const {
+        return thresholdSemaphore != nullptr;
+    }
+
+    // Blocks the calling task until a threshold is crossed or timeoutMs passes (0 waits forever).
+    // Returns true on a crossing; the task uses no CPU while it waits
+    bool waitForThreshold(unsigned long timeoutMs) {
+        if (thresholdSemaphore == nullptr)
+            return false;
+        TickType_t ticks = timeoutMs == 0 ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+        return xSemaphoreTake(thresholdSemaphore, ticks) == pdTRUE;
+    }
+
+    // Sets the interrupt window around state: leaving Normal, or coming back from Low or High by
+    // THRESHOLD_HYSTERESIS, raises the next interrupt. An Error state watches the normal range
+    void armThresholds(TemperatureState state) {
+#if SOC_TEMPERATURE_SENSOR_INTR_SUPPORT
+        if (thresholdSemaphore == nullptr)
+            return;
+        temperature_sensor_abs_threshold_config_t thresholds = {};
+        thresholds.low_threshold = lowThreshold;
+        thresholds.high_threshold = highThreshold;
+        if (state == Low) {
+            thresholds.low_threshold = RANGE_MIN;
+            thresholds.high_threshold = lowThreshold + THRESHOLD_HYSTERESIS;
+        } else if (state == High) {
+            thresholds.low_threshold = highThreshold - THRESHOLD_HYSTERESIS;
+            thresholds.high_threshold = RANGE_MAX;
+        }
+        temperature_sensor_set_absolute_threshold(tsens, &thresholds);
+#endif
     }
 
     // Reads the temperature from the sensor
     float readTemperature() {
-        static unsigned long lastErrorTime = 0; // Timestamp of the last sensor error
-        if (millis() - lastErrorTime < 6000) { // Wait for 60 seconds after an error
+        if (inCooldown && millis() - lastErrorTime < ERROR_COOLDOWN_MS) { // Wait for 60 seconds after an error
             Serial.println("Waiting for sensor cooldown...");
             return NAN;
         }
+        inCooldown = false;
 
         float temperature = 0.0;
         esp_err_t result = temperature_sensor_get_celsius(tsens, &temperature);
 
         if (result != ESP_OK) {
+            inCooldown = true;
             lastErrorTime = millis(); // Update the last error time
             Serial.println("Failed to read temperature. Entering cooldown.");
             return NAN;
@@ -231,60 +394,79 @@ public:
     }
 };
 
+// Indication of each temperature state, indexed by TemperatureSensor::TemperatureState
+struct StateIndication {
+    const IndicatorPattern *pattern;   // LED pattern of the state
+    BuzzerController::AlertType alert; // Alert played on every reading in the state
+};
+
+constexpr StateIndication stateIndications[] = {
+    {&NORMAL_PATTERN, BuzzerController::ALERT_MUTE}, // Normal: green LED, no sound
+    {&LOW_PATTERN, BuzzerController::ALERT_LOW},     // Low: blue LED, two short beeps
+    {&HIGH_PATTERN, BuzzerController::ALERT_MUTE},   // High: blinking red LED, the pattern beeps with every blink
+    {&ERROR_PATTERN, BuzzerController::ALERT_ERROR}, // Error: steady red LED, three long low beeps
+};
+
 // Global objects for controlling the LED, buzzer, and temperature sensor
-LEDController ledController(LED_PIN, STRIP_COUNT);
 BuzzerController buzzerController(BUZZER_PIN);
+LEDController ledController(LED_PIN, STRIP_COUNT, buzzerController);
+IndicatorEngine<LEDController> indicatorEngine(ledController);
 TemperatureSensor tempSensor(lowTempThreshold, highTempThreshold);
 
+// Reads the temperature, prints it and updates the LED and buzzer accordingly
+void reportTemperature() {
+    float temperatureC = tempSensor.readTemperature(); // Read temperature in Celsius
+    float temperatureF = temperatureC * 9 / 5 + 32; // Convert to Fahrenheit
+    TemperatureSensor::TemperatureState state = tempSensor.getTemperatureState(temperatureC); // Determine temperature state
+    tempSensor.armThresholds(state); // Next threshold interrupt when the state may end
+
+    // Print the temperature readings
+    Serial.print("Temperature: ");
+    Serial.print(temperatureC);
+    Serial.print(" °C, ");
+    Serial.print(temperatureF);
+    Serial.print(" °F, ");
+
+    // Update LED and buzzer based on temperature state
+    const StateIndication &indication = stateIndications[state];
+    bool entered = indicatorEngine.current() != indication.pattern; // The state changed since the last reading
+    if (entered || indication.alert != BuzzerController::ALERT_MUTE)
+        buzzerController.beep(indication.alert); // Alert of the state, silences the previous state on a change
+    if (entered)
+        indicatorEngine.play(*indication.pattern); // Restarting only on a change keeps the blink phase
+
+    // Print the current color, the pattern started from the timer task right away
+    Serial.println("Current LED Color: " + ledController.getCurrentLEDColor());
+}
+
 void setup() {
     Serial.begin(115200); // Initialize serial communication
     ledController.begin(); // Initialize the LED controller
+    if (!buzzerController.begin()) // Attach the buzzer to LEDC and create the tone timer
+        Serial.println("Failed to set up the buzzer.");
+    if (!indicatorEngine.begin()) // Create the timer that plays the LED patterns
+        Serial.println("Failed to create the indicator timer.");
+    tempSensor.begin(TEMP_SENSOR_EVENT_MODE); // Install the sensor, with the threshold interrupt in event mode
     ESP32Info::initializeSerial(); // Initialize serial connection for ESP32 information
     ESP32Info::printChipInfo(); // Print information about the ESP32-C6 chip
 }
 
 void loop() {
-    unsigned long currentMillis = millis(); // Get the current system time
+    if (tempSensor.thresholdEventsEnabled()) {
+        // Sleep until a threshold crossing or the heartbeat, the first pass reads at once
+        static bool hasReported = false;
+        if (hasReported && tempSensor.waitForThreshold(TEMP_SENSOR_HEARTBEAT_MS)) {
+            Serial.print("Threshold crossed. ");
+        }
+        hasReported = true;
+        reportTemperature();
+        return;
+    }
 
     // Periodically read the temperature and update the LED and buzzer accordingly
+    unsigned long currentMillis = millis(); // Get the current system time
     if (currentMillis - lastReadTime >= readInterval) {
         lastReadTime = currentMillis; // Update the last read time
-
-        float temperatureC = tempSensor.readTemperature(); // Read temperature in Celsius
-        float temperatureF = temperatureC * 9 / 5 + 32; // Convert to Fahrenheit
-        TemperatureSensor::TemperatureState state = tempSensor.getTemperatureState(temperatureC); // Determine temperature state
-
-        // Print the temperature readings
-        Serial.print("Temperature: ");
-        Serial.print(temperatureC);
-        Serial.print(" °C, ");
-        Serial.print(temperatureF);
-        Serial.print(" °F, ");
-
-        // Update LED and buzzer based on temperature state
-        switch (state) {
-            case TemperatureSensor::Low:
-                ledController.setColor(LEDController::Colors::Blue); // Set LED to blue
-                buzzerController.beep(BuzzerController::ALERT_LOW); // Low temperature alert
-                break;
-            /* case TemperatureSensor::High:
-                ledController.setColor(LEDController::Colors::Red); // Set LED to blink red
-                buzzerController.beep(BuzzerController::ALERT_HIGH); // High temperature alert
-                break; */
-            case TemperatureSensor::Normal:
-                ledController.setColor(LEDController::Colors::Green); // Set LED to green
-                buzzerController.beep(BuzzerController::ALERT_MUTE); // Medium temperature alert (no sound)    
-                break;
-            case TemperatureSensor::Error:
-                ledController.setColor(LEDController::Colors::Red); // Set LED to steady red
-                buzzerController.beep(BuzzerController::ALERT_ERROR); // Sensor error alert
-                break;
-        }
-
-        // Print the current color after setting it
-        Serial.println("Current LED Color: " + ledController.getCurrentLEDColor());
+        reportTemperature();
     }
-
-    // Handle LED blinking independently of temperature reading
-    ledController.handleBlink(LEDController::Colors::Red, currentMillis, buzzerController);
 }
@@ -0,0 +1,88 @@
+// **********************************
+// Project: Multi Sensor Detection System
+// Created by: Senior Software Developer
+// Creation Date: 2026-10-14
+// IDE: PlatformIO
+// **********************************
+// Code Explanation
+// **********************************
+// Code Purpose:
+// This code runs the vibration, tilt, PIR motion and HC-SR04 distance sensors together on one ESP32 C3.
+// One RGB LED and one Piezo Buzzer alert while any of the sensors detects something.
+// The sensor, LED and buzzer handling comes from the shared SensorFramework in Chapter_08/lib.
+// Hardware Connection:
+// - Vibration D0 pin -> GPIO0
+// - Tilt D0 pin -> GPIO1
+// - HC-SR501 pin -> GPIO4
+// - Ultrasonic sensor trig pin -> GPIO5, echo pin -> GPIO6
+// - RGB LED Red -> GPIO2, Green -> GPIO3, Blue -> GPIO10
+// - Piezo Buzzer -> GPIO11
+// **********************************
+// Libraries Import
+// **********************************
+#include <Arduino.h>
+#include <SensorFramework.h>
+#include <SwitchSensor.h>
+#include <RangeSensor.h>
+
+// **********************************
+// Constants and Variables Declaration
+// **********************************
+constexpr unsigned long SENSOR_READ_INTERVAL = 1000; // Status report interval in milliseconds
+
+// * Sensor settings
+struct VibrationSensorConfig
+{
+    static constexpr const char *NAME = "Vibration"; // Name in the status report
+    static constexpr int PIN = 0;                    // Pin connected to the vibration sensor D0
+    static constexpr int ACTIVE_LEVEL = HIGH;        // D0 level while vibration is detected
+    static constexpr uint32_t DEBOUNCE_US = 20000;   // Quiet time before a release is reported
+};
+
+struct TiltSensorConfig
+{
+    static constexpr const char *NAME = "Tilt";    // Name in the status report
+    static constexpr int PIN = 1;                  // Pin connected to the tilt sensor D0
+    static constexpr int ACTIVE_LEVEL = HIGH;      // D0 level while tilted
+    static constexpr uint32_t DEBOUNCE_US = 20000; // Quiet time before a release is reported
+};
+
+struct MotionSensorConfig
+{
+    static constexpr const char *NAME = "Motion";  // Name in the status report
+    static constexpr int PIN = 4;                  // Pin connected to the HC-SR501 output
+    static constexpr int ACTIVE_LEVEL = HIGH;      // Output level while motion is detected
+    static constexpr uint32_t DEBOUNCE_US = 20000; // Quiet time before a release is reported
+};
+
+struct DistanceSensorConfig
+{
+    static constexpr const char *NAME = "Proximity"; // Name in the status report
+    static constexpr int TRIG_PIN = 5;               // Ultrasonic sensor trig pin
+    static constexpr int ECHO_PIN = 6;               // Ultrasonic sensor echo pin
+    static constexpr uint32_t PERIOD_MS = 40;        // Continuous ranging at 25 Hz
+    static constexpr float ALARM_RANGE_CM = 10.0;    // Alarm while an object is closer than this
+};
+
+SensorScheduler<SwitchSensor<VibrationSensorConfig>,
+                SwitchSensor<TiltSensorConfig>,
+                SwitchSensor<MotionSensorConfig>,
+                RangeSensor<DistanceSensorConfig>>
+    scheduler(SENSOR_READ_INTERVAL); // All sensors on one LED and buzzer with the default wiring
+
+// **********************************
+// Setup Function
+// **********************************
+void setup()
+{
+    Serial.begin(115200);
+    scheduler.begin(); // Setup the LED and buzzer PWM and start every sensor
+}
+
+// **********************************
+// Main Loop
+// **********************************
+void loop()
+{
+    scheduler.run(); // Update the indicator on every change, print the status every SENSOR_READ_INTERVAL
+}
@@ -19,6 +19,7 @@
 // **********************************
 #include <Arduino.h>
 #include "DHT.h"
+#include "SamplingEngine.h" // Adaptive sampling and report-by-exception, shared from Chapter_08/lib
 
 // **********************************
 // Constants and Variables Declaration
@@ -51,8 +52,17 @@ constexpr int PWM_BUZZER_RESOLUTION = 10;   // Resolution for Buzzer PWM (10-bit
 constexpr int PWM_BUZZER_VOLUME_HALF = 512; // Half volume for the buzzer
 constexpr int PWM_BUZZER_OFF = 0;           // Turn off the buzzer
 
-constexpr unsigned long SENSOR_READ_INTERVAL = 1000; // Read interval in milliseconds
-unsigned long lastCheckTime = 0;                     // Last time the sensor was checked
+constexpr unsigned long SENSOR_READ_INTERVAL = 1000;       // Fast read interval, the shortest the DHT11 supports
+constexpr unsigned long SENSOR_SLOW_READ_INTERVAL = 5000;  // Read interval while readings are stable and away from the thresholds
+constexpr unsigned long SENSOR_HEARTBEAT_INTERVAL = 60000; // Longest time between two status reports
+unsigned long lastCheckTime = 0;                           // Last time the sensor was checked
+
+// * Adaptive sampling, the indicators and the status report only follow real changes
+constexpr SamplingChannelConfig DHT_SAMPLING_CHANNELS[] = {
+    {0.5, 0.2, TEMP_NORMAL_LOW, TEMP_NORMAL_HIGH, 1.0}, // Temperature: 0.5 C deadband, fast within 1 C of a threshold or above 0.2 C/s
+    {2.0, 1.0, HUM_NORMAL_LOW, HUM_NORMAL_HIGH, 3.0},   // Humidity: 2 % deadband, fast within 3 % of a threshold or above 1 %/s
+};
+SamplingEngine<2> dhtSampling(DHT_SAMPLING_CHANNELS, {SENSOR_SLOW_READ_INTERVAL, SENSOR_READ_INTERVAL, SENSOR_HEARTBEAT_INTERVAL});
 
 int currentRedState = 0; // 0 means off, values > 0 mean on (at various intensities)
 int currentGreenState = 0;
@@ -91,7 +101,7 @@ void setup()
 // **********************************
 void loop()
 {
-    if (millis() - lastCheckTime >= SENSOR_READ_INTERVAL)
+    if (millis() - lastCheckTime >= dhtSampling.intervalMs()) // Faster near the thresholds and during transitions
     {
         lastCheckTime = millis();
         float humidity = 0.0;
@@ -99,8 +109,12 @@ void loop()
         float temperatureF = 0.0;
 
         readDHTSensor(humidity, temperatureC, temperatureF);
-        updateIndicatorStatus(humidity, temperatureC);
-        printSystemStatus(temperatureC, temperatureF, humidity);
+        float values[] = {temperatureC, humidity};
+        if (dhtSampling.update(values, lastCheckTime)) // Only act on a change, a threshold crossing or the heartbeat
+        {
+            updateIndicatorStatus(humidity, temperatureC);
+            printSystemStatus(temperatureC, temperatureF, humidity);
+        }
     }
 }
 
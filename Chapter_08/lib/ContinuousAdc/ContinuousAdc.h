@@ -0,0 +1,183 @@
+// ContinuousAdc.h
+#ifndef ContinuousAdc_h
+#define ContinuousAdc_h
+
+#include <Arduino.h>
+#include <math.h>
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include <esp_adc/adc_continuous.h>
+#else
+#include <driver/adc.h>
+#endif
+
+// Aggregates of one window of ADC samples, in raw 12-bit counts
+struct AnalogStats
+{
+    uint16_t min;     // Lowest sample
+    uint16_t max;     // Highest sample
+    float mean;       // Average of the samples
+    float rms;        // Root mean square of the samples
+    uint32_t samples; // Samples in the window
+};
+
+// Continuous sampling of one ADC1 pin by the DMA controller, no analogRead() polling.
+// The driver keeps two conversion frames, DMA fills one while update() reduces the other.
+// update() folds every sample into min/max/sum/sum of squares in a single integer pass and
+// hands out an AnalogStats each windowSamples samples; the raw samples never leave the class.
+class ContinuousAdc
+{
+public:
+    // sampleRateHz must be within SOC_ADC_SAMPLE_FREQ_THRES_LOW and SOC_ADC_SAMPLE_FREQ_THRES_HIGH
+    ContinuousAdc(int pin, uint32_t sampleRateHz, uint32_t windowSamples) : pin(pin), sampleRateHz(sampleRateHz), windowSamples(windowSamples) {}
+
+    // Set up the DMA driver and start converting, returns false if the pin has no ADC1 channel
+    bool begin()
+    {
+        int analogChannel = digitalPinToAnalogChannel(pin);
+        if (analogChannel < 0 || analogChannel >= SOC_ADC_CHANNEL_NUM(0))
+            return false; // ADC2 is not usable in continuous mode
+        channel = analogChannel;
+
+        adc_digi_pattern_config_t pattern = {};
+        pattern.atten = ADC_ATTEN_DB_11; // Full 0-3.3 V range
+        pattern.channel = channel;
+        pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+        pattern.unit = ADC_UNIT_1;
+        adc_continuous_handle_cfg_t handleConfig = {};
+        handleConfig.max_store_buf_size = 2 * FRAME_BYTES; // Double buffered frames
+        handleConfig.conv_frame_size = FRAME_BYTES;
+        if (adc_continuous_new_handle(&handleConfig, &handle) != ESP_OK)
+            return false;
+        adc_continuous_evt_cbs_t callbacks = {};
+        callbacks.on_pool_ovf = onPoolOverflow;
+        adc_continuous_register_event_callbacks(handle, &callbacks, this);
+
+        adc_continuous_config_t config = {};
+        config.pattern_num = 1;
+        config.adc_pattern = &pattern;
+        config.sample_freq_hz = sampleRateHz;
+        config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+        config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+        if (adc_continuous_config(handle, &config) != ESP_OK)
+            return false;
+        return adc_continuous_start(handle) == ESP_OK;
+#else
+        pattern.unit = 0; // ADC1, the pattern takes the unit index in IDF 4.4
+        adc_digi_init_config_t initConfig = {};
+        initConfig.max_store_buf_size = 2 * FRAME_BYTES; // Double buffered frames
+        initConfig.conv_num_each_intr = FRAME_BYTES;
+        initConfig.adc1_chan_mask = BIT(channel);
+        if (adc_digi_initialize(&initConfig) != ESP_OK)
+            return false;
+
+        adc_digi_configuration_t config = {};
+        config.conv_limit_en = false;
+        config.conv_limit_num = 250;
+        config.pattern_num = 1;
+        config.adc_pattern = &pattern;
+        config.sample_freq_hz = sampleRateHz;
+        config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+        config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+        if (adc_digi_controller_configure(&config) != ESP_OK)
+            return false;
+        return adc_digi_start() == ESP_OK;
+#endif
+    }
+
+    // Call from loop(), reduces the frames DMA finished and returns true when a window completed
+    bool update(AnalogStats &stats)
+    {
+        bool completed = false;
+        uint32_t length = 0;
+        while (readFrame(length))
+        {
+            if (reduce(length))
+            {
+                stats = windowStats;
+                completed = true;
+            }
+        }
+        return completed;
+    }
+
+    uint32_t overruns() const { return overrunCount; } // Frames the driver dropped because update() ran late
+
+private:
+    static constexpr uint32_t FRAME_SAMPLES = 64;                                           // Conversions per DMA frame
+    static constexpr uint32_t FRAME_BYTES = FRAME_SAMPLES * sizeof(adc_digi_output_data_t); // Bytes per DMA frame
+
+    const int pin;                            // Analog output of the sensor
+    const uint32_t sampleRateHz;              // Conversions per second
+    const uint32_t windowSamples;             // Samples per AnalogStats
+    uint8_t channel = 0;                      // ADC1 channel of pin
+    alignas(4) uint8_t frame[FRAME_BYTES];    // Frame being reduced
+    uint32_t count = 0;                       // Samples in the current window
+    uint32_t sum = 0;                         // Sum of the current window
+    uint64_t sumSquares = 0;                  // Sum of squares of the current window
+    uint16_t low = UINT16_MAX;                // Lowest sample of the current window
+    uint16_t high = 0;                        // Highest sample of the current window
+    AnalogStats windowStats = {};             // Last completed window
+    volatile uint32_t overrunCount = 0;       // Frames lost to overruns
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    adc_continuous_handle_t handle = nullptr; // Continuous ADC driver
+
+    static bool IRAM_ATTR onPoolOverflow(adc_continuous_handle_t, const adc_continuous_evt_data_t *, void *arg)
+    {
+        ContinuousAdc *self = static_cast<ContinuousAdc *>(arg);
+        self->overrunCount = self->overrunCount + 1;
+        return false; // No task to wake
+    }
+#endif
+
+    bool readFrame(uint32_t &length)
+    {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+        return handle != nullptr && adc_continuous_read(handle, frame, FRAME_BYTES, &length, 0) == ESP_OK && length > 0;
+#else
+        esp_err_t result = adc_digi_read_bytes(frame, FRAME_BYTES, &length, 0);
+        if (result == ESP_ERR_INVALID_STATE) // The data is valid, but older frames were overwritten
+            overrunCount++;
+        return (result == ESP_OK || result == ESP_ERR_INVALID_STATE) && length > 0;
+#endif
+    }
+
+    // Fold one frame into the window, the accumulators live in registers for the whole loop
+    bool reduce(uint32_t length)
+    {
+        const adc_digi_output_data_t *results = (const adc_digi_output_data_t *)frame;
+        uint32_t resultCount = length / sizeof(adc_digi_output_data_t);
+        uint32_t n = count, s = sum;
+        uint64_t sq = sumSquares;
+        uint16_t lo = low, hi = high;
+        bool completed = false;
+
+        for (uint32_t i = 0; i < resultCount; i++)
+        {
+            if (results[i].type2.channel != channel)
+                continue; // Not a conversion of this pin
+            uint16_t value = results[i].type2.data;
+            s += value;
+            sq += (uint32_t)value * value;
+            lo = value < lo ? value : lo;
+            hi = value > hi ? value : hi;
+            if (++n == windowSamples)
+            {
+                windowStats.min = lo;
+                windowStats.max = hi;
+                windowStats.mean = (float)s / n;
+                windowStats.rms = sqrtf((float)sq / n);
+                windowStats.samples = n;
+                completed = true;
+                n = 0, s = 0, sq = 0, lo = UINT16_MAX, hi = 0;
+            }
+        }
+
+        count = n, sum = s, sumSquares = sq, low = lo, high = hi;
+        return completed;
+    }
+};
+
+#endif // ContinuousAdc_h
@@ -0,0 +1,128 @@
+// EdgeCapture.h
+#ifndef EdgeCapture_h
+#define EdgeCapture_h
+
+#include <Arduino.h>
+#include <atomic>
+
+// Debounced state change of a switch-type sensor
+struct EdgeEvent
+{
+    bool active;          // State of the sensor after the change
+    uint32_t timestampUs; // micros() of the edge that caused the change
+};
+
+// GPIO interrupt capture for switch-type sensors (vibration, collision, tilt, PIR, ...).
+// The ISR stamps every edge with micros() into a single-producer single-consumer ring,
+// so pulses far shorter than the main loop period are never missed. poll() debounces the
+// raw edges in the main loop: activation is reported on the first active edge, release
+// once the line has stayed inactive for debounceUs. Use one EdgeCapture per pin.
+template <size_t RING_SIZE = 32>
+class EdgeCapture
+{
+    static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "RING_SIZE must be a power of two");
+
+public:
+    EdgeCapture(int pin, int activeLevel, uint32_t debounceUs) : pin(pin), activeLevel(activeLevel), debounceUs(debounceUs) {}
+
+    // Read the current state and start capturing edges
+    void begin()
+    {
+        pinMode(pin, INPUT);
+        isActive = digitalRead(pin) == activeLevel;
+        isLineActive = isActive;
+        attachInterruptArg(digitalPinToInterrupt(pin), handleEdge, this, CHANGE);
+    }
+
+    void end() { detachInterrupt(digitalPinToInterrupt(pin)); } // Stop capturing edges
+
+    bool active() const { return isActive; } // Debounced state
+
+    // Take the next debounced state change, returns false if there is none
+    bool poll(EdgeEvent &event)
+    {
+        if (droppedEdges != seenDroppedEdges) // The ring overflowed, the last level seen may be stale
+        {
+            seenDroppedEdges = droppedEdges;
+            isLineActive = digitalRead(pin) == activeLevel;
+            lastEdgeUs = micros();
+        }
+
+        uint32_t tail = ringTail.load(std::memory_order_relaxed);
+        uint32_t head = ringHead.load(std::memory_order_acquire);
+        while (tail != head)
+        {
+            Edge edge = ring[tail & (RING_SIZE - 1)];
+            ringTail.store(++tail, std::memory_order_release); // Hand the slot back to the ISR
+            lastEdgeUs = edge.timestampUs;
+            isLineActive = edge.level == activeLevel;
+            if (isLineActive && !isActive) // Leading edge, report it right away
+            {
+                isActive = true;
+                activations++;
+                event = {true, edge.timestampUs};
+                return true;
+            }
+        }
+
+        // Bounces keep the sensor active, release once the line stays inactive
+        if (isActive && !isLineActive && micros() - lastEdgeUs >= debounceUs)
+        {
+            isActive = false;
+            event = {false, lastEdgeUs};
+            return true;
+        }
+        return false;
+    }
+
+    // Activations since the previous call, for per-window counts
+    uint32_t takeWindowCount()
+    {
+        uint32_t count = activations - windowStartActivations;
+        windowStartActivations = activations;
+        return count;
+    }
+
+    uint32_t totalActivations() const { return activations; } // Debounced activations since begin()
+    uint32_t rawEdges() const { return edgeCount; }           // Edges seen by the ISR, bounces included
+    uint32_t lostEdges() const { return droppedEdges; }       // Edges dropped because the ring was full
+
+private:
+    struct Edge
+    {
+        uint32_t timestampUs; // micros() in the ISR
+        uint8_t level;        // Line level right after the edge
+    };
+
+    const int pin;                       // Sensor output pin
+    const int activeLevel;               // Level the sensor drives when it detects something
+    const uint32_t debounceUs;           // Quiet time before a release is reported
+    Edge ring[RING_SIZE];                // Raw edges from the ISR
+    std::atomic<uint32_t> ringHead{0};   // Written by the ISR only
+    std::atomic<uint32_t> ringTail{0};   // Written by poll() only
+    volatile uint32_t edgeCount = 0;     // Written by the ISR only
+    volatile uint32_t droppedEdges = 0;  // Written by the ISR only
+    uint32_t seenDroppedEdges = 0;       // droppedEdges at the previous poll()
+    uint32_t activations = 0;            // Debounced activations
+    uint32_t windowStartActivations = 0; // activations at the previous takeWindowCount()
+    uint32_t lastEdgeUs = 0;             // Time of the newest edge taken from the ring
+    bool isActive = false;               // Debounced state
+    bool isLineActive = false;           // Line level after the newest edge taken from the ring
+
+    // Only 32-bit loads and stores on the indices, safe without atomic instructions on the ESP32-C3
+    static void IRAM_ATTR handleEdge(void *arg)
+    {
+        EdgeCapture *self = static_cast<EdgeCapture *>(arg);
+        uint32_t head = self->ringHead.load(std::memory_order_relaxed);
+        self->edgeCount = self->edgeCount + 1;
+        if (head - self->ringTail.load(std::memory_order_acquire) >= RING_SIZE)
+        {
+            self->droppedEdges = self->droppedEdges + 1;
+            return;
+        }
+        self->ring[head & (RING_SIZE - 1)] = {(uint32_t)micros(), (uint8_t)digitalRead(self->pin)};
+        self->ringHead.store(head + 1, std::memory_order_release);
+    }
+};
+
+#endif // EdgeCapture_h
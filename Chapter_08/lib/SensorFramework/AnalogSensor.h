@@ -0,0 +1,57 @@
+// AnalogSensor.h
+#ifndef AnalogSensor_h
+#define AnalogSensor_h
+
+#include <Arduino.h>
+#include "ContinuousAdc.h"
+
+// Analog output (AO) sampled by DMA, alarms on the window mean. Config members:
+//   const char *NAME, int PIN, uint32_t SAMPLE_RATE_HZ, uint32_t WINDOW_MS,
+//   float ALARM_LEVEL, bool ALARM_ABOVE (alarm at or above ALARM_LEVEL, else at or below)
+// The ADC has one DMA controller, so an image can hold only one AnalogSensor.
+template <typename Config>
+class AnalogSensor
+{
+public:
+    AnalogSensor() : adc(Config::PIN, Config::SAMPLE_RATE_HZ, Config::SAMPLE_RATE_HZ * Config::WINDOW_MS / 1000) {}
+
+    void begin()
+    {
+        if (!adc.begin())
+            Serial.println("Error: continuous ADC setup failed");
+    }
+
+    bool update()
+    {
+        if (!adc.update(stats))
+            return false;
+        isAlarm = Config::ALARM_ABOVE ? stats.mean >= Config::ALARM_LEVEL : stats.mean <= Config::ALARM_LEVEL;
+        return true;
+    }
+
+    bool alarm() const { return isAlarm; }
+
+    void printStatus()
+    {
+        Serial.print(Config::NAME);
+        Serial.print(" Detected: ");
+        Serial.println(isAlarm ? "YES" : "NO");
+        Serial.print("Analog Min/Max: ");
+        Serial.print(stats.min);
+        Serial.print(" / ");
+        Serial.println(stats.max);
+        Serial.print("Analog Mean/RMS: ");
+        Serial.print(stats.mean);
+        Serial.print(" / ");
+        Serial.println(stats.rms);
+        Serial.print("ADC Overruns: ");
+        Serial.println(adc.overruns());
+    }
+
+private:
+    ContinuousAdc adc;      // DMA sampling of PIN
+    AnalogStats stats = {}; // Last completed window
+    bool isAlarm = false;   // Alarm state of the last window
+};
+
+#endif // AnalogSensor_h
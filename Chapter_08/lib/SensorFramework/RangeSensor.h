@@ -0,0 +1,59 @@
+// RangeSensor.h
+#ifndef RangeSensor_h
+#define RangeSensor_h
+
+#include <Arduino.h>
+#include <math.h>
+#include "UltrasonicRanger.h"
+
+// HC-SR04 ranging, alarms while an object is closer than ALARM_RANGE_CM. Config members:
+//   const char *NAME, int TRIG_PIN, int ECHO_PIN, uint32_t PERIOD_MS, float ALARM_RANGE_CM
+template <typename Config>
+class RangeSensor
+{
+public:
+    RangeSensor() : ranger(Config::TRIG_PIN, Config::ECHO_PIN) {}
+
+    void begin()
+    {
+        if (!ranger.begin())
+            Serial.println("Error: RMT ranging setup failed");
+        ranger.startContinuous(Config::PERIOD_MS);
+    }
+
+    bool update()
+    {
+        if (!ranger.update())
+            return false;
+        float distance = ranger.distanceCm();
+        isAlarm = !isnan(distance) && distance < Config::ALARM_RANGE_CM;
+        return true;
+    }
+
+    bool alarm() const { return isAlarm; }
+
+    void printStatus()
+    {
+        float distance = ranger.distanceCm();
+        Serial.print(Config::NAME);
+        Serial.print(" Detected: ");
+        Serial.println(isAlarm ? "YES" : "NO");
+        Serial.print("Distance: ");
+        if (isnan(distance))
+            Serial.println("out of range");
+        else
+        {
+            Serial.print(distance);
+            Serial.println(" cm");
+        }
+        Serial.print("Invalid echoes: ");
+        Serial.print(ranger.takeInvalidRate() * 100.0f);
+        Serial.println(" %");
+    }
+
+private:
+    UltrasonicRanger ranger; // RMT timed ranging
+    bool isAlarm = false;    // An object is within ALARM_RANGE_CM
+};
+
+#endif // RangeSensor_h
@@ -0,0 +1,169 @@
+// SensorFramework.h
+#ifndef SensorFramework_h
+#define SensorFramework_h
+
+#include <Arduino.h>
+
+// Shared runtime of the Chapter_08 sensor sketches.
+// A sensor is any class with the members below; the set of sensors is a template parameter
+// list, so the calls are resolved at compile time without virtual dispatch:
+//   void begin();          // Set up the hardware
+//   bool update();         // Non-blocking, returns true when alarm() may have changed
+//   bool alarm() const;    // The sensor currently detects something
+//   void printStatus();    // Print the state and the statistics of the last report window
+// SwitchSensor.h, AnalogSensor.h and RangeSensor.h provide sensors configured by a struct of
+// static constexpr members. SensorScheduler runs any number of them on one Indicator.
+
+// * Indicator
+// RGB LED and buzzer wiring, DEFAULT_INDICATOR matches the hardware connection of the book
+struct IndicatorConfig
+{
+    int redPin;                // Red LED pin
+    int greenPin;              // Green LED pin
+    int bluePin;               // Blue LED pin
+    int buzzerPin;             // Pin connected to the Piezo Buzzer
+    uint8_t redChannel;        // PWM channel for Red LED
+    uint8_t greenChannel;      // PWM channel for Green LED
+    uint8_t blueChannel;       // PWM channel for Blue LED
+    uint8_t buzzerChannel;     // PWM channel for Piezo Buzzer
+    uint32_t ledFrequency;     // Suitable frequency for LEDs
+    uint8_t ledResolution;     // 8-bit resolution (0-255)
+    uint32_t buzzerFrequency;  // Frequency for Buzzer PWM
+    uint8_t buzzerResolution;  // Resolution for Buzzer PWM (10-bit = 0-1023)
+    uint32_t buzzerVolumeHalf; // Half volume for the buzzer
+};
+
+constexpr IndicatorConfig DEFAULT_INDICATOR = {2, 3, 10, 11, 1, 2, 3, 0, 5000, 8, 2000, 10, 512};
+
+// Red LED and buzzer while any sensor alarms, green LED otherwise
+class Indicator
+{
+public:
+    explicit Indicator(const IndicatorConfig &config) : config(config) {}
+
+    void begin()
+    {
+        ledcSetup(config.redChannel, config.ledFrequency, config.ledResolution);          // Setup PWM channel for Red LED
+        ledcAttachPin(config.redPin, config.redChannel);                                  // Attach Red LED to PWM channel
+        ledcSetup(config.greenChannel, config.ledFrequency, config.ledResolution);        // Setup PWM channel for Green LED
+        ledcAttachPin(config.greenPin, config.greenChannel);                              // Attach Green LED to PWM channel
+        ledcSetup(config.blueChannel, config.ledFrequency, config.ledResolution);         // Setup PWM channel for Blue LED
+        ledcAttachPin(config.bluePin, config.blueChannel);                                // Attach Blue LED to PWM channel
+        ledcSetup(config.buzzerChannel, config.buzzerFrequency, config.buzzerResolution); // Setup PWM channel for Buzzer
+        ledcAttachPin(config.buzzerPin, config.buzzerChannel);                            // Attach Buzzer to PWM channel
+    }
+
+    // Only writes the LEDC duty when the alarm state changes
+    void show(bool alarm)
+    {
+        if (hasShown && alarm == isAlarm)
+            return;
+        hasShown = true;
+        isAlarm = alarm;
+        uint32_t ledOn = (1u << config.ledResolution) - 1;
+        ledcWrite(config.redChannel, alarm ? ledOn : 0);
+        ledcWrite(config.greenChannel, alarm ? 0 : ledOn);
+        ledcWrite(config.blueChannel, 0);
+        ledcWrite(config.buzzerChannel, alarm ? config.buzzerVolumeHalf : 0);
+    }
+
+    void printStatus() const
+    {
+        Serial.print("Red LED State: ");
+        Serial.println(isAlarm ? "ON" : "OFF");
+        Serial.print("Green LED State: ");
+        Serial.println(isAlarm ? "OFF" : "ON");
+        Serial.print("Buzzer State: ");
+        Serial.println(isAlarm ? "ON" : "OFF");
+    }
+
+private:
+    const IndicatorConfig config; // Wiring and PWM settings
+    bool hasShown = false;        // show() ran at least once
+    bool isAlarm = false;         // State shown on the LED and buzzer
+};
+
+// * Scheduler
+// Compile-time list of sensors, each call visits all of them in order
+template <typename... Sensors>
+class SensorSet;
+
+template <>
+class SensorSet<>
+{
+public:
+    void begin() {}
+    bool update() { return false; }
+    bool alarm() const { return false; }
+    void printStatus() {}
+};
+
+template <typename First, typename... Rest>
+class SensorSet<First, Rest...>
+{
+public:
+    void begin()
+    {
+        first.begin();
+        rest.begin();
+    }
+
+    bool update()
+    {
+        bool changed = first.update(); // Every sensor is serviced, no short circuit
+        return rest.update() || changed;
+    }
+
+    bool alarm() const { return first.alarm() || rest.alarm(); }
+
+    void printStatus()
+    {
+        first.printStatus();
+        rest.printStatus();
+    }
+
+private:
+    First first;
+    SensorSet<Rest...> rest;
+};
+
+// Runs every sensor from loop() without blocking, shows the combined alarm on the indicator
+// as soon as a sensor changes, and prints a status report every reportIntervalMs
+template <typename... Sensors>
+class SensorScheduler
+{
+public:
+    explicit SensorScheduler(uint32_t reportIntervalMs, const IndicatorConfig &indicatorConfig = DEFAULT_INDICATOR)
+        : reportIntervalMs(reportIntervalMs), indicator(indicatorConfig) {}
+
+    void begin()
+    {
+        indicator.begin();
+        sensors.begin();
+        indicator.show(sensors.alarm()); // Initial state of the sensors
+    }
+
+    // Call from loop()
+    void run()
+    {
+        if (sensors.update())
+            indicator.show(sensors.alarm());
+
+        if (millis() - lastReportMs >= reportIntervalMs)
+        {
+            lastReportMs = millis();
+            sensors.printStatus();
+            indicator.printStatus();
+        }
+    }
+
+    bool alarm() const { return sensors.alarm(); } // Any sensor detects something
+
+private:
+    const uint32_t reportIntervalMs; // Time between two status reports
+    uint32_t lastReportMs = 0;       // Time of the last status report
+    Indicator indicator;             // The one LED and buzzer backend
+    SensorSet<Sensors...> sensors;   // Every sensor of the image
+};
+
+#endif // SensorFramework_h
@@ -0,0 +1,41 @@
+// SwitchSensor.h
+#ifndef SwitchSensor_h
+#define SwitchSensor_h
+
+#include <Arduino.h>
+#include "EdgeCapture.h"
+
+// Switch output (D0) captured in the GPIO interrupt. Config members:
+//   const char *NAME, int PIN, int ACTIVE_LEVEL, uint32_t DEBOUNCE_US
+template <typename Config>
+class SwitchSensor
+{
+public:
+    SwitchSensor() : capture(Config::PIN, Config::ACTIVE_LEVEL, Config::DEBOUNCE_US) {}
+
+    void begin() { capture.begin(); }
+
+    // One debounced event per call, so an alarm shorter than a loop pass still reaches the indicator
+    bool update()
+    {
+        EdgeEvent event;
+        return capture.poll(event);
+    }
+
+    bool alarm() const { return capture.active(); }
+
+    void printStatus()
+    {
+        Serial.print(Config::NAME);
+        Serial.print(" Detected: ");
+        Serial.println(capture.active() ? "YES" : "NO");
+        Serial.print(Config::NAME);
+        Serial.print(" Detections in Window: ");
+        Serial.println(capture.takeWindowCount());
+    }
+
+private:
+    EdgeCapture<> capture; // Debounced edges of PIN
+};
+
+#endif // SwitchSensor_h
@@ -0,0 +1,197 @@
+// UltrasonicRanger.h
+#ifndef UltrasonicRanger_h
+#define UltrasonicRanger_h
+
+#include <Arduino.h>
+#include <math.h>
+#include <driver/rmt.h>
+
+// HC-SR04 ranging on the RMT peripheral, the ESP32-C3 has no MCPWM capture.
+// A TX channel sends the 10 us trigger pulse and an RX channel times the echo in hardware,
+// so update() only starts the next trigger and picks up finished echoes without waiting.
+// Readings pass a median of the last MEDIAN_SIZE valid echoes and an EMA; distanceCm() is
+// NAN until the first valid echo and again after INVALID_LIMIT invalid readings in a row.
+class UltrasonicRanger
+{
+public:
+    static constexpr float SOUND_SPEED_CM_PER_US = 0.017; // Speed of sound (cm/us) / 2
+    static constexpr float MIN_RANGE_CM = 2.0;            // Closest distance the HC-SR04 resolves
+    static constexpr float MAX_RANGE_CM = 400.0;          // Farthest distance the HC-SR04 resolves
+
+    // rxChannel must be an RX capable channel, RMT_CHANNEL_2 or RMT_CHANNEL_3 on the ESP32-C3
+    UltrasonicRanger(int trigPin, int echoPin, rmt_channel_t txChannel = RMT_CHANNEL_0, rmt_channel_t rxChannel = RMT_CHANNEL_2)
+        : trigPin(trigPin), echoPin(echoPin), txChannel(txChannel), rxChannel(rxChannel) {}
+
+    // Install both RMT channels, returns false if the driver could not be installed
+    bool begin()
+    {
+        rmt_config_t txConfig = RMT_DEFAULT_CONFIG_TX((gpio_num_t)trigPin, txChannel);
+        txConfig.clk_div = RMT_CLK_DIV; // 1 us ticks
+        rmt_config_t rxConfig = RMT_DEFAULT_CONFIG_RX((gpio_num_t)echoPin, rxChannel);
+        rxConfig.clk_div = RMT_CLK_DIV;
+        rxConfig.rx_config.filter_en = true;
+        rxConfig.rx_config.filter_ticks_thresh = RX_FILTER_APB_TICKS;
+        rxConfig.rx_config.idle_threshold = ECHO_IDLE_TICKS;
+
+        if (rmt_config(&txConfig) != ESP_OK || rmt_driver_install(txChannel, 0, 0) != ESP_OK)
+            return false;
+        if (rmt_config(&rxConfig) != ESP_OK || rmt_driver_install(rxChannel, RX_BUFFER_SIZE, 0) != ESP_OK)
+            return false;
+        if (rmt_get_ringbuf_handle(rxChannel, &rxBuffer) != ESP_OK)
+            return false;
+        return rmt_rx_start(rxChannel, true) == ESP_OK;
+    }
+
+    // Trigger a new measurement every periodMs from update(), 0 stops continuous ranging
+    void startContinuous(uint32_t periodMs) { continuousPeriodMs = periodMs; }
+
+    // Send one trigger pulse, returns false while the previous echo is still being timed
+    bool trigger()
+    {
+        if (isMeasuring || rxBuffer == nullptr)
+            return false;
+        discardFrames(); // Drop echoes nobody asked for, such as late reflections
+        rmt_item32_t pulse = {};
+        pulse.level0 = 1;
+        pulse.duration0 = TRIGGER_PULSE_US;
+        pulse.level1 = 0;
+        pulse.duration1 = 0; // End marker
+        if (rmt_write_items(txChannel, &pulse, 1, false) != ESP_OK)
+            return false;
+        isMeasuring = true;
+        triggerMs = millis();
+        return true;
+    }
+
+    // Call from loop(), returns true when a measurement finished
+    bool update()
+    {
+        if (!isMeasuring)
+        {
+            if (continuousPeriodMs != 0 && millis() - triggerMs >= continuousPeriodMs)
+                trigger();
+            return false;
+        }
+
+        size_t length = 0;
+        rmt_item32_t *items = (rmt_item32_t *)xRingbufferReceive(rxBuffer, &length, 0);
+        if (items == nullptr)
+        {
+            if (millis() - triggerMs < FRAME_TIMEOUT_MS)
+                return false;
+            addReading(NAN); // No edge at all, the sensor is missing or unpowered
+            return true;
+        }
+
+        // The capture starts at the rising edge of the echo, so the first half item is its width.
+        // When the echo stays high past ECHO_IDLE_TICKS the width reads 0 and the echo is invalid
+        float distance = NAN;
+        if (length >= sizeof(rmt_item32_t) && items[0].level0 == 1)
+        {
+            float cm = items[0].duration0 * SOUND_SPEED_CM_PER_US;
+            if (cm >= MIN_RANGE_CM && cm <= MAX_RANGE_CM)
+                distance = cm;
+        }
+        vRingbufferReturnItem(rxBuffer, items);
+        addReading(distance);
+        return true;
+    }
+
+    bool busy() const { return isMeasuring; }                 // An echo is being timed
+    float distanceCm() const { return filteredCm; }           // Filtered distance, NAN without a valid echo
+    float rawDistanceCm() const { return lastRawCm; }         // Latest reading, NAN if it was invalid
+    uint32_t readings() const { return readingCount; }        // Measurements since begin()
+    uint32_t invalidReadings() const { return invalidCount; } // Measurements without a valid echo
+
+    // Share of the measurements since the previous call without a valid echo, 0.0 to 1.0
+    float takeInvalidRate()
+    {
+        uint32_t total = readingCount - windowStartReadings;
+        uint32_t invalid = invalidCount - windowStartInvalid;
+        windowStartReadings = readingCount;
+        windowStartInvalid = invalidCount;
+        return total == 0 ? 0.0f : (float)invalid / total;
+    }
+
+private:
+    static constexpr uint8_t RMT_CLK_DIV = 80;          // 80 MHz APB / 80 = 1 us per tick
+    static constexpr uint8_t RX_FILTER_APB_TICKS = 100; // Ignore glitches shorter than 1.25 us
+    static constexpr uint16_t TRIGGER_PULSE_US = 10;    // Trigger width the HC-SR04 asks for
+    static constexpr uint32_t FRAME_TIMEOUT_MS = 60;    // Give up on a capture that never started
+    static constexpr size_t RX_BUFFER_SIZE = 256;       // RX ring buffer, enough for a few echo frames
+    static constexpr size_t MEDIAN_SIZE = 5;            // Valid echoes in the median filter
+    static constexpr float EMA_ALPHA = 0.5;             // Weight of the newest median in the EMA
+    static constexpr uint8_t INVALID_LIMIT = 5;         // Invalid readings in a row that reset the filter
+
+    // A capture ends after this many ticks without an edge: the longest valid echo plus a margin
+    static constexpr uint16_t ECHO_IDLE_TICKS = (uint16_t)(MAX_RANGE_CM / SOUND_SPEED_CM_PER_US) + 1000;
+
+    const int trigPin;                    // HC-SR04 trig pin
+    const int echoPin;                    // HC-SR04 echo pin
+    const rmt_channel_t txChannel;        // RMT channel of the trigger pulse
+    const rmt_channel_t rxChannel;        // RMT channel timing the echo
+    RingbufHandle_t rxBuffer = nullptr;   // Echo frames from the RMT driver
+    uint32_t continuousPeriodMs = 0;      // Trigger period of continuous ranging, 0 when off
+    uint32_t triggerMs = 0;               // millis() of the last trigger
+    bool isMeasuring = false;             // Waiting for the echo of the last trigger
+    float medianWindow[MEDIAN_SIZE] = {}; // Latest valid readings, oldest overwritten first
+    size_t medianCount = 0;               // Valid entries in medianWindow
+    size_t medianNext = 0;                // Slot of the next valid reading
+    float filteredCm = NAN;               // EMA of the median
+    float lastRawCm = NAN;                // Latest reading
+    uint8_t invalidInRow = 0;             // Invalid readings since the last valid one
+    uint32_t readingCount = 0;            // Measurements since begin()
+    uint32_t invalidCount = 0;            // Invalid measurements since begin()
+    uint32_t windowStartReadings = 0;     // readingCount at the previous takeInvalidRate()
+    uint32_t windowStartInvalid = 0;      // invalidCount at the previous takeInvalidRate()
+
+    void discardFrames()
+    {
+        size_t length = 0;
+        void *item;
+        while ((item = xRingbufferReceive(rxBuffer, &length, 0)) != nullptr)
+            vRingbufferReturnItem(rxBuffer, item);
+    }
+
+    void addReading(float distance)
+    {
+        isMeasuring = false;
+        readingCount++;
+        lastRawCm = distance;
+        if (isnan(distance))
+        {
+            invalidCount++;
+            if (++invalidInRow >= INVALID_LIMIT) // Nothing in range any more
+            {
+                invalidInRow = INVALID_LIMIT;
+                medianCount = 0;
+                medianNext = 0; // The window refills from slot 0, medianOf() reads slots below medianCount
+                filteredCm = NAN;
+            }
+            return;
+        }
+
+        invalidInRow = 0;
+        medianWindow[medianNext] = distance;
+        medianNext = (medianNext + 1) % MEDIAN_SIZE;
+        if (medianCount < MEDIAN_SIZE)
+            medianCount++;
+        float median = medianOf(medianWindow, medianCount);
+        filteredCm = isnan(filteredCm) ? median : filteredCm + EMA_ALPHA * (median - filteredCm);
+    }
+
+    static float medianOf(const float *values, size_t count)
+    {
+        float sorted[MEDIAN_SIZE];
+        for (size_t i = 0; i < count; i++) // Insertion sort, at most MEDIAN_SIZE values
+        {
+            size_t j = i;
+            for (; j > 0 && sorted[j - 1] > values[i]; j--)
+                sorted[j] = sorted[j - 1];
+            sorted[j] = values[i];
+        }
+        return count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+    }
+};
+
+#endif // UltrasonicRanger_h
@@ -22,11 +22,10 @@
 // - indicateConditionBelowRange()
 // - indicateConditionAboveRange()
 // - indicateSensorError()
-// - blinkLEDs()
-// - updateStatusLEDs()
 // - connectToWiFi()
 // - pingHost()
 // - syncNTP()
+// - configureWiFiAddress()
 // Security Considerations:
 // - Ensure stable power supply to prevent erroneous readings.
 // - Avoid exposing the sensor to extreme conditions beyond its operating range.
@@ -36,16 +35,28 @@
 // **********************************
 // * Libraries Import
 // **********************************
-#include <Arduino.h>   // Include the Arduino base library
-#include "DHT.h"       // Include the library for the DHT sensor
-#include <WiFi.h>      // Include the WiFi library
-#include <ESP32Ping.h> // Include the Ping library
-#include <Update.h>    // Include the Update library
+#include <Arduino.h>         // Include the Arduino base library
+#include "DHT.h"             // Include the library for the DHT sensor
+#include <WiFi.h>            // Include the WiFi library
+#include <ESP32Ping.h>       // Include the Ping library
+#include <Update.h>          // Include the Update library
+#include "WiFiCache.h"       // Include the cached Wi-Fi association for fast reconnects
+#include "IndicatorEngine.h" // Include the timer driven LED and buzzer patterns
 
 // **********************************
 // * Constants Declaration
 // **********************************
 
+// * Wi-Fi address settings, set WIFI_STATIC_IP, WIFI_STATIC_GATEWAY, WIFI_STATIC_SUBNET and WIFI_STATIC_DNS in build_flags to skip DHCP
+#ifndef WIFI_REUSE_LEASE
+#define WIFI_REUSE_LEASE 0 // 1 reuses the cached DHCP lease as a static address, only where the router reserves it
+#endif
+#ifdef WIFI_STATIC_IP
+constexpr bool WIFI_USE_CACHED_LEASE = false; // The static address wins over the cached lease
+#else
+constexpr bool WIFI_USE_CACHED_LEASE = WIFI_REUSE_LEASE;
+#endif
+
 // * ESP32 Reboot Delay
 constexpr int ESP32_REBOOT_DELAY_MS = 5000; // Delay before rebooting the ESP32
 
@@ -98,19 +109,42 @@ enum SensorConditionStatus
 };
 SensorConditionStatus currentCondition = SensorError; // Default to Error until the first successful reading
 
-// * Blinking control variables
-bool isBlinkingEnabled = false;                  // Flag for LED blinking state
-unsigned long lastBlinkTime = 0;                 // Last time the LED blinked
-constexpr long DATA_LED_BLINK_INTERVAL_MS = 100; // Interval between blinks
-int blinkingLED = -1;                            // Assuming -1 as an invalid value indicating no LED is set for blinking.
+// * Indicator patterns, played by an esp_timer so they keep time while the loop blocks
+constexpr uint16_t DATA_LED_BLINK_INTERVAL_MS = 100; // Interval between blinks
+constexpr uint8_t INDICATOR_RED = 1 << 0;            // Bit of the red data LED
+constexpr uint8_t INDICATOR_GREEN = 1 << 1;          // Bit of the green data LED
+constexpr uint8_t INDICATOR_BLUE = 1 << 2;           // Bit of the blue data LED
+constexpr uint8_t INDICATOR_SENSOR_ERROR = 1 << 3;   // Bit of LED D5
+constexpr uint8_t INDICATOR_BUZZER = 1 << 4;         // Bit of the Piezo Buzzer
+constexpr IndicatorOutput INDICATOR_OUTPUTS[] = {
+    {DATA_LED_ABOVE_RED, -1, HIGH},
+    {DATA_LED_NORMAL_GREEN, -1, HIGH},
+    {DATA_LED_BELOW_BLUE, -1, HIGH},
+    {SYS_LED_D5, SYS_LED_D5_CHANNEL, SYS_LED_ON},
+    {BUZZER_PIN, BUZZER_CHANNEL, BUZZER_VOLUME_HALF},
+};
+constexpr IndicatorPattern NORMAL_PATTERN = {1, {{INDICATOR_GREEN, 0}}};                                   // Green LED on
+constexpr IndicatorPattern SENSOR_ERROR_PATTERN = {1, {{INDICATOR_SENSOR_ERROR | INDICATOR_BUZZER, 0}}}; // LED D5 and buzzer on
+constexpr IndicatorPattern BELOW_RANGE_PATTERN = {2, {
+    {INDICATOR_BLUE | INDICATOR_BUZZER, DATA_LED_BLINK_INTERVAL_MS}, // Blue LED and buzzer on
+    {0, DATA_LED_BLINK_INTERVAL_MS},                                 // Everything off
+}};
+constexpr IndicatorPattern ABOVE_RANGE_PATTERN = {2, {
+    {INDICATOR_RED | INDICATOR_BUZZER, DATA_LED_BLINK_INTERVAL_MS}, // Red LED and buzzer on
+    {0, DATA_LED_BLINK_INTERVAL_MS},                                // Everything off
+}};
+IndicatorOutputs<5> indicatorOutputs(INDICATOR_OUTPUTS);                 // Data LEDs, LED D5 and buzzer
+IndicatorEngine<IndicatorOutputs<5>> indicatorEngine(indicatorOutputs); // Player of the patterns
 
 // * WiFi, Ping and NTP Sync settings
 const char *ssid = WIFI_SSID;                               // WiFi SSID
 const char *password = WIFI_PASSWORD;                       // WiFi password
 const char *host = PING_HOST;                               // Host to ping
 constexpr int MAX_WIFI_CONNECT_ATTEMPTS = 3;                // Maximum number of WiFi connection attempts
-constexpr unsigned long WIFI_CONNECT_RETRY_DELAY_MS = 5000; // Delay between WiFi connection attempts
+constexpr unsigned long WIFI_CONNECT_RETRY_DELAY_MS = 5000; // Longest wait for each WiFi connection attempt
+constexpr unsigned long WIFI_FAST_CONNECT_TIMEOUT_MS = 1500; // Longest wait for the directed association to the cached access point
 const char *ntpServer = NTP_SERVER;                         // NTP server
+WiFiCache wifiCache;                                        // Last good channel, BSSID and IP lease, kept in NVS
 constexpr unsigned long NTP_SYNC_DELAY_MS = 1000;           // Delay between NTP time sync attempts
 
 // * Initialize the DHT11
@@ -118,15 +152,14 @@ DHT dht(DHT_PIN, DHT_TYPE); // Initialize DHT sensor
 
 // * Declare functions
 void checkSensorReadings(float &humidity, float &temperatureC, float &temperatureF); // Function to read and process sensor data
-void updateStatusLEDs(bool isRedOn, bool isGreenOn, bool isBlueOn);                  // Function to update the RGB LED
 void indicateNormalCondition();                                                      // Function to indicate normal conditions
 void indicateConditionBelowRange();                                                  // Function to indicate condition below range
 void indicateConditionAboveRange();                                                  // Function to indicate condition above range
 void indicateSensorError();                                                          // Function to indicate sensor error
-void blinkLEDs();                                                                    // Function to handle LED blinking and buzzer beeping
 void connectToWiFi();                                                                // Function to connect to WiFi
 void pingHost();                                                                     // Function to ping a host
 void syncNTP();                                                                      // Function to initialize NTP
+void configureWiFiAddress();                                                         // Function to apply the static IP from build_flags, if any
 
 // **********************************
 // & Setup Function
@@ -140,9 +173,7 @@ void setup()
     dht.begin(); // Initialize the DHT sensor
 
     // Set Data LED pins as output
-    pinMode(DATA_LED_ABOVE_RED, OUTPUT);    // Set LED RED pin as output
-    pinMode(DATA_LED_NORMAL_GREEN, OUTPUT); // Set LED GREEN pin as output
-    pinMode(DATA_LED_BELOW_BLUE, OUTPUT);   // Set LED BLUE pin as output
+    indicatorOutputs.begin(); // pinMode() of the RGB LED pins
 
     // Setup and Attach PWM channels to System LED D4
     ledcSetup(SYS_LED_D4_CHANNEL, SYS_LED_FREQ, SYS_LED_RESOLUTION); // Setup LEDC channel for LED D4
@@ -156,6 +187,9 @@ void setup()
     ledcSetup(BUZZER_CHANNEL, BUZZER_FREQ, BUZZER_RESOLUTION); // Setup LEDC channel for Piezo Buzzer
     ledcAttachPin(BUZZER_PIN, BUZZER_CHANNEL);                 // Attach Piezo Buzzer to PWM channel
 
+    if (!indicatorEngine.begin()) // Create the timer that plays the indicator patterns
+        Serial.println("Failed to create the indicator timer, conditions are not shown");
+
     Serial.println("DHT11 sensor monitoring started."); // Inform the user that monitoring has started
 
     connectToWiFi(); // Connect to WiFi
@@ -195,8 +229,6 @@ void loop()
             }
         }
     }
-
-    blinkLEDs(); // Handle LED blinking and buzzer beeping
 }
 
 // **********************************
@@ -244,84 +276,47 @@ void checkSensorReadings(float &humidity, float &temperatureC, float &temperatur
     }
 }
 
-void updateStatusLEDs(bool isRedOn, bool isGreenOn, bool isBlueOn) // Function to update the RGB LED
-{
-    digitalWrite(DATA_LED_ABOVE_RED, isRedOn ? HIGH : LOW);      // Turn on or off the red LED
-    digitalWrite(DATA_LED_NORMAL_GREEN, isGreenOn ? HIGH : LOW); // Turn on or off the green LED
-    digitalWrite(DATA_LED_BELOW_BLUE, isBlueOn ? HIGH : LOW);    // Turn on or off the blue LED
-}
-
 void indicateNormalCondition() // Function to indicate normal conditions
 {
-    isBlinkingEnabled = false;                  // Stop blinking
-    updateStatusLEDs(false, true, false);       // Turn on GREEN LED, off others
-    ledcWrite(SYS_LED_D5_CHANNEL, SYS_LED_OFF); // Turn LED D5 off
-    ledcWrite(BUZZER_CHANNEL, BUZZER_OFF);      // Mute the buzzer
+    indicatorEngine.play(NORMAL_PATTERN);       // Turn on GREEN LED, off others, LED D5 and buzzer off
     Serial.println("Current LED Color: GREEN"); // Print current LED color
 }
 
 void indicateConditionBelowRange() // Function to indicate condition below range
 {
-    isBlinkingEnabled = true;                           // Indicate that the blue LED should blink
-    ledcWrite(SYS_LED_D5_CHANNEL, SYS_LED_OFF);         // Turn LED D5 off
-    blinkingLED = DATA_LED_BELOW_BLUE;                  // Blink the blue LED
+    indicatorEngine.play(BELOW_RANGE_PATTERN);          // Blink the blue LED with the buzzer, LED D5 off
     Serial.println("Current LED Color: BLUE Blinking"); // Updated print statement
 }
 
 void indicateConditionAboveRange() // Function to indicate condition above range
 {
-    isBlinkingEnabled = true;                          // Indicate that the red LED should blink
-    ledcWrite(SYS_LED_D5_CHANNEL, SYS_LED_OFF);        // Turn LED D5 off
-    blinkingLED = DATA_LED_ABOVE_RED;                  // Blink the red LED
+    indicatorEngine.play(ABOVE_RANGE_PATTERN);         // Blink the red LED with the buzzer, LED D5 off
     Serial.println("Current LED Color: RED Blinking"); // Updated print statement
 }
 
 void indicateSensorError() // Function to indicate sensor error
 {
-    isBlinkingEnabled = false;                     // Stop blinking
-    updateStatusLEDs(false, false, false);         // Turn off all LEDs
-    ledcWrite(SYS_LED_D5_CHANNEL, SYS_LED_ON);     // Turn LED D5 solid red
-    ledcWrite(BUZZER_CHANNEL, BUZZER_VOLUME_HALF); // Set buzzer to half volume
-    Serial.println("Sensor Error!");               // Print sensor error message
+    indicatorEngine.play(SENSOR_ERROR_PATTERN); // Turn off all data LEDs, LED D5 solid red, buzzer at half volume
+    Serial.println("Sensor Error!");            // Print sensor error message
 }
 
-void blinkLEDs() // Function to handle LED blinking and buzzer beeping
+void connectToWiFi() // Function to connect to WiFi
 {
-    if (!isBlinkingEnabled) // Check if blinking is not enabled
-        return;             // Exit if blinking is not enabled
+    Serial.println("Connecting to WiFi...");
+    unsigned long connectStart = millis();
+    WiFi.mode(WIFI_STA);    // Set WiFi mode to station to connect to a WiFi network
+    configureWiFiAddress(); // Skip DHCP when a static IP is configured
 
-    unsigned long currentMillis = millis();                          // Get current time
-    if (currentMillis - lastBlinkTime >= DATA_LED_BLINK_INTERVAL_MS) // Check if it's time to toggle the LED state
+    // Directed association to the last good access point skips the channel scan
+    if (!wifiCache.connectCached(ssid, password, WIFI_FAST_CONNECT_TIMEOUT_MS, WIFI_USE_CACHED_LEASE))
     {
-        lastBlinkTime = currentMillis; // Update the last blink time
-        static bool ledState = false;  // Toggle state variable
-        ledState = !ledState;          // Toggle the state
-
-        // Determine which LED to blink based on the condition
-        if (blinkingLED == DATA_LED_BELOW_BLUE)
-        {
-            updateStatusLEDs(false, false, ledState); // Blink Blue LED for below range
-        }
-        else if (blinkingLED == DATA_LED_ABOVE_RED)
-        {
-            updateStatusLEDs(ledState, false, false); // Blink Red LED for above range
-        }
-
-        // Synchronize the buzzer beeping with LED blinking
-        ledcWrite(BUZZER_CHANNEL, ledState ? BUZZER_VOLUME_HALF : BUZZER_OFF);
+        Serial.println("No cached access point, scanning...");
+        WiFi.begin(ssid, password); // Start the connection process with a full scan
     }
-}
-
-void connectToWiFi() // Function to connect to WiFi
-{
-    Serial.println("Connecting to WiFi...");
-    WiFi.mode(WIFI_STA);        // Set WiFi mode to station to connect to a WiFi network
-    WiFi.begin(ssid, password); // Start the connection process
 
     int attempts = 0;                                                             // Initialize the number of connection attempts
-    while (WiFi.status() != WL_CONNECTED && attempts < MAX_WIFI_CONNECT_ATTEMPTS) // Check if WiFi is not connected and the number of attempts is less than the maximum
+    while (attempts < MAX_WIFI_CONNECT_ATTEMPTS && !WiFiCache::waitForConnection(WIFI_CONNECT_RETRY_DELAY_MS)) // Wait up to 5 seconds per attempt, returns as soon as WiFi is connected
     {
-        delay(WIFI_CONNECT_RETRY_DELAY_MS); // Wait 5 seconds between attempts
         attempts++;
         Serial.print("Attempt ");
         Serial.print(attempts);
@@ -338,7 +333,10 @@ void connectToWiFi() // Function to connect to WiFi
     if (WiFi.status() == WL_CONNECTED) // Check if WiFi is connected
     {
         // If connected successfully, turn off LED D4 and print the IP address and RSSI
-        Serial.println("Connected to WiFi successfully!");
+        Serial.print("Connected to WiFi successfully in ");
+        Serial.print(millis() - connectStart);
+        Serial.println(" ms!");
+        wifiCache.save(); // Remember the access point and lease for the next boot
         Serial.print("WiFi SSID: ");
         Serial.println(WiFi.SSID());
         Serial.print("IP Address: ");
@@ -361,6 +359,14 @@ void connectToWiFi() // Function to connect to WiFi
     }
 }
 
+void configureWiFiAddress() // Function to apply the static IP from build_flags, if any
+{
+#ifdef WIFI_STATIC_IP
+    if (!WiFiCache::configureStaticIP(WIFI_STATIC_IP, WIFI_STATIC_GATEWAY, WIFI_STATIC_SUBNET, WIFI_STATIC_DNS))
+        Serial.println("Invalid static IP settings, using DHCP");
+#endif
+}
+
 void pingHost() // Function to ping a host
 {
     Serial.print("Pinging host: " + String(host) + "...");
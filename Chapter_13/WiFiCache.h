@@ -0,0 +1,118 @@
+// WiFiCache.h
+#ifndef WiFiCache_h
+#define WiFiCache_h
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Preferences.h>
+
+// Last good Wi-Fi association (channel, BSSID and IP lease) persisted in NVS.
+// A reboot or deep sleep wake-up associates straight to the cached access point,
+// skipping the channel scan, and optionally reuses the lease to skip DHCP as well.
+class WiFiCache
+{
+public:
+    // Read the cache from NVS, returns false if nothing usable is stored
+    bool load()
+    {
+        Preferences preferences;
+        if (!preferences.begin(NVS_NAMESPACE, true))
+            return false;
+        size_t length = preferences.getBytes(NVS_KEY, &entry, sizeof(entry));
+        preferences.end();
+        return length == sizeof(entry) && entry.version == ENTRY_VERSION && entry.channel != 0;
+    }
+
+    // Store the current association, NVS is only written when something changed
+    void save()
+    {
+        Entry current = {};
+        current.version = ENTRY_VERSION;
+        current.channel = WiFi.channel();
+        memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+        current.ip = WiFi.localIP();
+        current.gateway = WiFi.gatewayIP();
+        current.subnet = WiFi.subnetMask();
+        current.dns = WiFi.dnsIP();
+        if (memcmp(&current, &entry, sizeof(entry)) == 0)
+            return;
+
+        entry = current;
+        Preferences preferences;
+        if (preferences.begin(NVS_NAMESPACE, false))
+        {
+            preferences.putBytes(NVS_KEY, &entry, sizeof(entry));
+            preferences.end();
+        }
+    }
+
+    // Forget the cached association, the next connection scans
+    void clear()
+    {
+        entry = {};
+        Preferences preferences;
+        if (preferences.begin(NVS_NAMESPACE, false))
+        {
+            preferences.remove(NVS_KEY);
+            preferences.end();
+        }
+    }
+
+    // Associate to the cached access point, on failure the cache is dropped and DHCP restored for the scan
+    bool connectCached(const char *ssid, const char *password, unsigned long timeoutMs, bool reuseLease)
+    {
+        if (!load())
+            return false;
+
+        bool leaseApplied = reuseLease && entry.ip != 0;
+        if (leaseApplied) // Only safe where the router reserves the lease for this device
+            WiFi.config(IPAddress(entry.ip), IPAddress(entry.gateway), IPAddress(entry.subnet), IPAddress(entry.dns));
+
+        WiFi.begin(ssid, password, entry.channel, entry.bssid);
+        if (waitForConnection(timeoutMs))
+            return true;
+
+        WiFi.disconnect();
+        if (leaseApplied)
+            WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // Back to DHCP
+        clear();
+        return false;
+    }
+
+    // Use a fixed address instead of DHCP, returns false if an address does not parse
+    static bool configureStaticIP(const char *ip, const char *gateway, const char *subnet, const char *dns)
+    {
+        IPAddress localIP, gatewayIP, subnetMask, dnsIP;
+        if (!localIP.fromString(ip) || !gatewayIP.fromString(gateway) || !subnetMask.fromString(subnet) || !dnsIP.fromString(dns))
+            return false;
+        return WiFi.config(localIP, gatewayIP, subnetMask, dnsIP);
+    }
+
+    // Poll the association every 10 ms, so a fast connect is not padded to a fixed delay
+    static bool waitForConnection(unsigned long timeoutMs)
+    {
+        unsigned long start = millis();
+        while (WiFi.status() != WL_CONNECTED && millis() - start < timeoutMs)
+            delay(10);
+        return WiFi.status() == WL_CONNECTED;
+    }
+
+private:
+    static constexpr const char *NVS_NAMESPACE = "wifi_cache"; // NVS namespace of the cache
+    static constexpr const char *NVS_KEY = "assoc";            // NVS key of the Entry blob
+    static constexpr uint8_t ENTRY_VERSION = 1;                // Bumped when Entry changes
+
+    struct Entry
+    {
+        uint8_t version;  // ENTRY_VERSION of the stored blob
+        uint8_t channel;  // Channel of the access point, 0 if unknown
+        uint8_t bssid[6]; // MAC address of the access point
+        uint32_t ip;      // Leased address
+        uint32_t gateway; // Gateway of the lease
+        uint32_t subnet;  // Subnet mask of the lease
+        uint32_t dns;     // DNS server of the lease
+    };
+    Entry entry = {}; // Cache contents, last loaded or saved
+};
+
+#endif // WiFiCache_h
@@ -0,0 +1,79 @@
+// ArenaAllocator.h
+#ifndef ArenaAllocator_h
+#define ArenaAllocator_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Bump allocator over a fixed buffer for ArduinoJson documents.
+// Memory is only given back by reset(), so a document built after each reset() reuses
+// the same static bytes and never touches the heap. When the arena is exhausted
+// allocate() returns nullptr and the document reports overflowed().
+template <size_t N>
+class ArenaAllocator : public ArduinoJson::Allocator
+{
+public:
+    void *allocate(size_t size) override
+    {
+        size_t needed = align(HEADER_SIZE + size);
+        if (used + needed > N)
+            return nullptr;
+
+        uint8_t *block = buffer + used;
+        *reinterpret_cast<size_t *>(block) = size; // Remember the size for reallocate()
+        lastBlock = block;
+        used += needed;
+        if (used > peak)
+            peak = used;
+        return block + HEADER_SIZE;
+    }
+
+    void deallocate(void *) override {} // Everything is released at once by reset()
+
+    void *reallocate(void *ptr, size_t newSize) override
+    {
+        if (ptr == nullptr)
+            return allocate(newSize);
+
+        uint8_t *block = static_cast<uint8_t *>(ptr) - HEADER_SIZE;
+        size_t oldSize = *reinterpret_cast<size_t *>(block);
+        if (block == lastBlock) // The newest block grows or shrinks in place
+        {
+            size_t end = (block - buffer) + align(HEADER_SIZE + newSize);
+            if (end > N)
+                return nullptr;
+            *reinterpret_cast<size_t *>(block) = newSize;
+            used = end;
+            if (used > peak)
+                peak = used;
+            return ptr;
+        }
+        if (newSize <= oldSize) // Shrinking an older block keeps it where it is
+            return ptr;
+
+        void *moved = allocate(newSize);
+        if (moved != nullptr)
+            memcpy(moved, ptr, oldSize);
+        return moved;
+    }
+
+    void reset() // Release every block, only call once the document using it is gone
+    {
+        used = 0;
+        lastBlock = nullptr;
+    }
+
+    size_t peakUsage() const { return peak; } // Highest number of bytes in use since boot
+    size_t capacity() const { return N; }     // Size of the arena
+
+private:
+    static constexpr size_t HEADER_SIZE = 8;                             // Block size field, keeps 8-byte alignment
+    static size_t align(size_t size) { return (size + 7) & ~(size_t)7; } // Round up to 8 bytes
+
+    alignas(8) uint8_t buffer[N]; // Arena storage
+    size_t used = 0;              // Bytes handed out since the last reset()
+    size_t peak = 0;              // Highest value of used
+    uint8_t *lastBlock = nullptr; // Newest block, the only one that can grow in place
+};
+
+#endif // ArenaAllocator_h
@@ -0,0 +1,129 @@
+// DHT11Sensor.h
+#ifndef DHT11Sensor_h
+#define DHT11Sensor_h
+
+#include <Arduino.h>
+
+// Result of one DHT11 transaction
+enum DHT11Status
+{
+    DHT11_OK,             // Frame received and checksum valid
+    DHT11_NO_RESPONSE,    // Sensor did not answer the start signal, wiring or power problem
+    DHT11_TIMING_ERROR,   // Sensor answered but a bit took too long, usually an interrupted read
+    DHT11_CHECKSUM_ERROR, // Frame received but the checksum does not match
+};
+
+struct DHT11Reading
+{
+    uint8_t raw[5];     // Humidity int/dec, temperature int/dec, checksum as sent by the sensor
+    DHT11Status status; // Outcome of the transaction
+    float humidity;     // Relative humidity in %, NAN unless status is DHT11_OK
+    float temperatureC; // Temperature in °C, NAN unless status is DHT11_OK
+    float temperatureF; // Temperature in °F computed from temperatureC, NAN unless status is DHT11_OK
+    uint32_t latencyUs; // Time spent in read(), start signal included
+};
+
+// Bit-banged DHT11 driver, one bus transaction per reading.
+// The sensor needs at least DHT11Sensor::MIN_READ_INTERVAL_MS between transactions.
+class DHT11Sensor
+{
+public:
+    static constexpr uint32_t MIN_READ_INTERVAL_MS = 1000; // Shortest interval the DHT11 supports
+
+    explicit DHT11Sensor(int pin) : pin(pin) {}
+
+    void begin()
+    {
+        pinMode(pin, INPUT_PULLUP); // Idle high, the sensor only pulls the line down
+    }
+
+    DHT11Reading read()
+    {
+        DHT11Reading reading = {};
+        reading.humidity = NAN;
+        reading.temperatureC = NAN;
+        reading.temperatureF = NAN;
+        uint32_t startTime = micros();
+
+        // Start signal, at least 18 ms low, may sleep since no timing is measured yet
+        pinMode(pin, OUTPUT);
+        digitalWrite(pin, LOW);
+        delay(START_SIGNAL_MS);
+
+        // The response and the 40 data bits are timed, keep interrupts out of the way for ~4 ms
+        portENTER_CRITICAL(&mux);
+        pinMode(pin, INPUT_PULLUP);
+        reading.status = receiveFrame(reading.raw);
+        portEXIT_CRITICAL(&mux);
+
+        if (reading.status == DHT11_OK)
+        {
+            uint8_t sum = reading.raw[0] + reading.raw[1] + reading.raw[2] + reading.raw[3];
+            if (sum != reading.raw[4])
+            {
+                reading.status = DHT11_CHECKSUM_ERROR;
+            }
+            else
+            {
+                reading.humidity = reading.raw[0] + reading.raw[1] * 0.1f;
+                reading.temperatureC = reading.raw[2] + (reading.raw[3] & 0x0F) * 0.1f;
+                if (reading.raw[3] & 0x80) // Sign bit of newer DHT11 revisions
+                    reading.temperatureC = -reading.temperatureC;
+                reading.temperatureF = reading.temperatureC * 1.8f + 32.0f;
+            }
+        }
+
+        reading.latencyUs = micros() - startTime;
+        return reading;
+    }
+
+    static const char *statusToString(DHT11Status status)
+    {
+        return status == DHT11_OK ? "OK" : status == DHT11_NO_RESPONSE ? "No response"
+                                       : status == DHT11_TIMING_ERROR  ? "Timing error"
+                                                                       : "Checksum error";
+    }
+
+private:
+    static constexpr uint32_t START_SIGNAL_MS = 20;      // Host start signal, datasheet minimum 18 ms
+    static constexpr uint32_t LEVEL_TIMEOUT_US = 100;    // Longest level of the protocol is 80 us
+    static constexpr uint32_t BIT_ONE_THRESHOLD_US = 40; // High for 26-28 us is a 0, 70 us is a 1
+
+    int pin;                                         // Data pin
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED; // Guards the timed part of the transaction
+
+    // Wait while the line stays at `level`, returns the time spent or LEVEL_TIMEOUT_US on timeout
+    uint32_t measureLevel(int level)
+    {
+        uint32_t start = micros();
+        uint32_t elapsed = 0;
+        while (digitalRead(pin) == level)
+        {
+            elapsed = micros() - start;
+            if (elapsed >= LEVEL_TIMEOUT_US)
+                return LEVEL_TIMEOUT_US;
+        }
+        return elapsed;
+    }
+
+    DHT11Status receiveFrame(uint8_t *raw)
+    {
+        // Sensor response: the line stays high up to 40 us, then 80 us low and 80 us high
+        if (measureLevel(HIGH) >= LEVEL_TIMEOUT_US || measureLevel(LOW) >= LEVEL_TIMEOUT_US || measureLevel(HIGH) >= LEVEL_TIMEOUT_US)
+            return DHT11_NO_RESPONSE;
+
+        // 40 bits, each a 50 us low followed by a high whose length is the bit value
+        for (int i = 0; i < 40; i++)
+        {
+            if (measureLevel(LOW) >= LEVEL_TIMEOUT_US)
+                return DHT11_TIMING_ERROR;
+            uint32_t highTime = measureLevel(HIGH);
+            if (highTime >= LEVEL_TIMEOUT_US)
+                return DHT11_TIMING_ERROR;
+            raw[i / 8] = (raw[i / 8] << 1) | (highTime > BIT_ONE_THRESHOLD_US ? 1 : 0);
+        }
+        return DHT11_OK;
+    }
+};
+
+#endif // DHT11Sensor_h
@@ -0,0 +1,165 @@
+// EdgeAggregator.h
+#ifndef EdgeAggregator_h
+#define EdgeAggregator_h
+
+#include <Arduino.h>
+#include <math.h>
+
+// Thresholds of one measured quantity
+struct EdgeChannelConfig
+{
+    float lowThreshold;  // Below it the quantity is low
+    float highThreshold; // Above it the quantity is high
+    float hysteresis;    // Distance back inside a threshold before a low or high quantity is normal again
+};
+
+// Streaming statistics of one quantity over the current summary window
+struct EdgeWindowStats
+{
+    uint32_t count; // Valid samples in the window
+    float mean;     // Running mean (Welford)
+    float m2;       // Sum of squared deviations from the mean (Welford)
+    float min;      // Lowest sample
+    float max;      // Highest sample
+    float ema;      // Exponential moving average, carried over from window to window
+
+    float variance() const { return count > 1 ? m2 / (count - 1) : 0.0f; } // Sample variance
+};
+
+// Level of one quantity after hysteresis and debouncing
+enum EdgeLevel : uint8_t
+{
+    EdgeNormal, // Between the thresholds
+    EdgeLow,    // Below the low threshold
+    EdgeHigh,   // Above the high threshold
+};
+
+// On-device aggregation of a sensor with N quantities read together, such as temperature and
+// humidity of one DHT11 transaction, so only condition changes and summaries go upstream.
+// Every sample is classified against the thresholds with hysteresis: a low or high quantity
+// stays so until it is back inside by the hysteresis, so a value hovering at a threshold does
+// not toggle. A new state, the levels of all quantities plus a sensor fault, must then be seen
+// on debounceSamples samples in a row before it is confirmed; update() returns true exactly
+// then. One noisy sample or one failed read therefore never reaches the cloud as an alarm.
+// Alongside, every valid sample feeds the window statistics (Welford mean and variance,
+// min/max, EMA) that the sketch reports and restarts with startWindow() every summary period.
+template <size_t N>
+class EdgeAggregator
+{
+public:
+    EdgeAggregator(const EdgeChannelConfig (&channelConfigs)[N], float emaAlpha, uint8_t debounceSamples)
+        : emaAlpha(emaAlpha), debounceSamples(debounceSamples > 0 ? debounceSamples : 1)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            channels[i] = channelConfigs[i];
+            stats[i].ema = NAN;
+        }
+        startWindow(0);
+    }
+
+    // Feed one sample, NAN marks a quantity the sensor did not deliver.
+    // Returns true when the sample confirms a new state, the first one included.
+    bool update(const float (&values)[N])
+    {
+        uint16_t candidate = 0;
+        for (size_t i = 0; i < N; i++)
+        {
+            float value = values[i];
+            if (isnan(value))
+            {
+                candidate |= FAULT_BIT;
+                continue;
+            }
+            addToWindow(stats[i], value);
+            candidate |= classify(channels[i], value, confirmedLevel(i)) << (2 * i);
+        }
+        if (candidate & FAULT_BIT)
+            faults++; // One failed read, however many quantities it lost
+
+        if (hasState && candidate == confirmed)
+        {
+            pendingCount = 0; // Back to the confirmed state, a pending change was noise
+            return false;
+        }
+        if (pendingCount == 0 || candidate != pending)
+        {
+            pending = candidate;
+            pendingCount = 0;
+        }
+        if (++pendingCount < debounceSamples)
+            return false;
+
+        confirmed = pending;
+        pendingCount = 0;
+        hasState = true;
+        changes++;
+        return true;
+    }
+
+    // Start a new summary window, the EMA carries over
+    void startWindow(uint32_t nowMs)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            float ema = stats[i].ema;
+            stats[i] = {};
+            stats[i].min = NAN;
+            stats[i].max = NAN;
+            stats[i].ema = ema;
+        }
+        faults = 0;
+        windowStartMs = nowMs;
+    }
+
+    bool hasConfirmedState() const { return hasState; }                       // A state has been confirmed since boot
+    EdgeLevel level(size_t i) const { return confirmedLevel(i); }             // Confirmed level of quantity i
+    bool isFault() const { return confirmed & FAULT_BIT; }                    // Confirmed sensor fault
+    const EdgeWindowStats &windowStats(size_t i) const { return stats[i]; }   // Statistics of quantity i in the window
+    uint32_t windowFaults() const { return faults; }                          // Samples with a missing quantity in the window
+    uint32_t windowMs(uint32_t nowMs) const { return nowMs - windowStartMs; } // Length of the window so far
+    uint32_t stateChanges() const { return changes; }                         // Confirmed changes since boot
+
+private:
+    static constexpr uint16_t FAULT_BIT = 0x8000; // Above the two level bits of every quantity
+    static_assert(2 * N <= 15, "EdgeAggregator keeps the levels of at most 7 quantities");
+
+    EdgeChannelConfig channels[N]; // Per quantity thresholds
+    EdgeWindowStats stats[N] = {}; // Per quantity window statistics
+    const float emaAlpha;          // Weight of a new sample in the EMA
+    const uint8_t debounceSamples; // Samples in a row that confirm a new state
+    uint16_t confirmed = 0;        // Confirmed state, two level bits per quantity and FAULT_BIT
+    uint16_t pending = 0;          // State waiting for its confirmation
+    uint8_t pendingCount = 0;      // Samples in a row in the pending state
+    bool hasState = false;         // confirmed is valid
+    uint32_t faults = 0;           // Samples with a missing quantity in the window
+    uint32_t windowStartMs = 0;    // Start of the window
+    uint32_t changes = 0;          // Confirmed changes since boot
+
+    EdgeLevel confirmedLevel(size_t i) const { return (EdgeLevel)((confirmed >> (2 * i)) & 0x03); }
+
+    // Level of a sample, a quantity that is low or high now needs the hysteresis to leave
+    static uint16_t classify(const EdgeChannelConfig &config, float value, EdgeLevel current)
+    {
+        if (value > config.highThreshold || (current == EdgeHigh && value > config.highThreshold - config.hysteresis))
+            return EdgeHigh;
+        if (value < config.lowThreshold || (current == EdgeLow && value < config.lowThreshold + config.hysteresis))
+            return EdgeLow;
+        return EdgeNormal;
+    }
+
+    void addToWindow(EdgeWindowStats &window, float value)
+    {
+        window.count++;
+        float delta = value - window.mean;
+        window.mean += delta / window.count;
+        window.m2 += delta * (value - window.mean);
+        if (window.count == 1 || value < window.min)
+            window.min = value;
+        if (window.count == 1 || value > window.max)
+            window.max = value;
+        window.ema = isnan(window.ema) ? value : window.ema + emaAlpha * (value - window.ema);
+    }
+};
+
+#endif // EdgeAggregator_h
@@ -0,0 +1,143 @@
+// IndicatorEngine.h
+#ifndef IndicatorEngine_h
+#define IndicatorEngine_h
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
+
+constexpr uint8_t INDICATOR_MAX_STEPS = 8; // Longest pattern
+
+// One step of a pattern: which outputs are on, and for how long
+struct IndicatorStep
+{
+    uint8_t outputs;     // Bit i switches output i on
+    uint16_t durationMs; // Time until the next step, 0 holds the step until the next play()
+};
+
+// A blink or beep pattern declared once as a constexpr table of steps.
+// After the last step the pattern starts over, unless the last step holds (durationMs 0).
+struct IndicatorPattern
+{
+    uint8_t stepCount;                        // Steps in use
+    IndicatorStep steps[INDICATOR_MAX_STEPS]; // Steps in play order
+};
+
+// An LED or buzzer output, an LEDC channel or a plain GPIO
+struct IndicatorOutput
+{
+    int pin;         // Output pin
+    int channel;     // LEDC channel set up by the sketch, -1 for a plain GPIO written with digitalWrite()
+    uint32_t onDuty; // LEDC duty while on, ignored for a GPIO
+};
+
+// N outputs addressed by the bits of IndicatorStep::outputs, only changed outputs are written
+template <size_t N>
+class IndicatorOutputs
+{
+public:
+    explicit IndicatorOutputs(const IndicatorOutput (&config)[N])
+    {
+        for (size_t i = 0; i < N; i++)
+            outputs[i] = config[i];
+    }
+
+    // Set the GPIO outputs as output, the LEDC channels are set up by the sketch
+    void begin()
+    {
+        for (size_t i = 0; i < N; i++)
+            if (outputs[i].channel < 0)
+                pinMode(outputs[i].pin, OUTPUT);
+    }
+
+    // force rewrites every output, taking back the ones written elsewhere
+    void write(uint8_t mask, bool force)
+    {
+        uint8_t changed = force ? 0xFF : mask ^ shown;
+        shown = mask;
+        for (size_t i = 0; i < N; i++)
+        {
+            if (!(changed & (1 << i)))
+                continue;
+            bool on = mask & (1 << i);
+            if (outputs[i].channel < 0)
+                digitalWrite(outputs[i].pin, on ? HIGH : LOW);
+            else
+                ledcWrite(outputs[i].channel, on ? outputs[i].onDuty : 0);
+        }
+    }
+
+private:
+    IndicatorOutput outputs[N]; // Outputs in bit order
+    uint8_t shown = 0;          // Mask currently on the outputs
+};
+
+// Plays IndicatorPatterns from a one-shot esp_timer, so blinking and beeping go on at the
+// exact step times however long loop() or a task blocks in a connection or a sync.
+// play() only hands the pattern over and returns; every output write happens in the
+// esp_timer task, once per step and only for outputs that change. The hand-over uses atomic
+// loads and stores only, the ESP32-C3 has no atomic read-modify-write instructions.
+// Outputs is any class with void write(uint8_t mask, bool force), such as IndicatorOutputs.
+template <typename Outputs>
+class IndicatorEngine
+{
+public:
+    explicit IndicatorEngine(Outputs &outputs) : outputs(outputs) {}
+
+    // Create the step timer, returns false if esp_timer has no room for it
+    bool begin()
+    {
+        esp_timer_create_args_t args = {};
+        args.callback = onTimer;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "indicator";
+        return esp_timer_create(&args, &timer) == ESP_OK;
+    }
+
+    // Switch to pattern from its first step, the pattern must outlive the playback
+    void play(const IndicatorPattern &pattern)
+    {
+        if (timer == nullptr)
+            return;
+        pending.store(&pattern);
+        playRequests.store(playRequests.load() + 1); // Only play() writes it, no read-modify-write needed
+        esp_timer_stop(timer);          // Cancel the wait for the next step of the old pattern
+        esp_timer_start_once(timer, 0); // First step right away
+    }
+
+    const IndicatorPattern *current() const { return playing.load(); } // Pattern being played, nullptr before the first play()
+
+private:
+    Outputs &outputs;                                       // LEDs and buzzer
+    esp_timer_handle_t timer = nullptr;                     // One-shot timer of the next step
+    std::atomic<const IndicatorPattern *> pending{nullptr}; // Pattern handed over by play()
+    std::atomic<const IndicatorPattern *> playing{nullptr}; // Pattern on the outputs
+    std::atomic<uint32_t> playRequests{0};                  // Calls of play(), written after pending
+    uint32_t handledRequests = 0;                           // playRequests at the last restart, timer task only
+    uint8_t step = 0;                                       // Next step of playing, timer task only
+
+    static void onTimer(void *arg)
+    {
+        IndicatorEngine *self = static_cast<IndicatorEngine *>(arg);
+        uint32_t requests = self->playRequests.load();
+        bool restart = requests != self->handledRequests;
+        if (restart) // A new pattern, start it from the first step
+        {
+            self->handledRequests = requests;
+            self->playing.store(self->pending.load());
+            self->step = 0;
+        }
+        const IndicatorPattern *pattern = self->playing.load();
+        if (pattern == nullptr || pattern->stepCount == 0)
+            return;
+
+        const IndicatorStep &active = pattern->steps[self->step];
+        self->outputs.write(active.outputs, restart);
+        self->step = (self->step + 1) % pattern->stepCount;
+        if (active.durationMs != 0)
+            esp_timer_start_once(self->timer, (uint64_t)active.durationMs * 1000);
+    }
+};
+
+#endif // IndicatorEngine_h
@@ -0,0 +1,188 @@
+// Log.h
+#ifndef Log_h
+#define Log_h
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// Leveled logging with the level fixed at compile time by LOG_LEVEL in build_flags.
+// A call above LOG_LEVEL compiles to nothing, its format string and arguments included; with
+// LOG_LEVEL_NONE the ring buffer and drain task are gone as well.
+// The logging task formats one line into its own stack and copies it into a RAM ring; a low
+// priority task moves the ring to Serial only as fast as the UART or USB CDC takes it, so a
+// slow or unplugged monitor never blocks the caller. Lines that find the ring full are
+// counted and dropped. Format strings stay in flash, string literals on the ESP32 are
+// mapped from flash and need no PROGMEM.
+#define LOG_LEVEL_NONE 0  // No diagnostics
+#define LOG_LEVEL_ERROR 1 // Failures the device does not recover from by itself
+#define LOG_LEVEL_WARN 2  // Failures with a fallback, such as a dropped reading
+#define LOG_LEVEL_INFO 3  // State changes, readings and connections
+#define LOG_LEVEL_DEBUG 4 // Payloads and periodic reports
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG // Everything, as the Serial prints did before
+#endif
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 4096 // Ring size in bytes, a power of two
+#endif
+
+#if LOG_LEVEL > LOG_LEVEL_NONE
+
+// Ring of log text, filled by any task and drained to Serial by its own task
+template <size_t SIZE>
+class LogBuffer
+{
+public:
+    static_assert((SIZE & (SIZE - 1)) == 0, "LOG_BUFFER_SIZE must be a power of two");
+    static constexpr size_t LINE_SIZE = 192;           // Longest printf() line, a longer one is cut off
+    static constexpr uint32_t DRAIN_PERIOD_MS = 10;    // Drain task period, about 1.4 KB per period at 115200 baud
+    static constexpr uint32_t DRAIN_STACK_SIZE = 2048; // Drain task stack in bytes
+
+    // Start the drain task, lines logged before are kept until it runs
+    bool begin(UBaseType_t priority = 1) { return xTaskCreate(drainTask, "log", DRAIN_STACK_SIZE, this, priority, &task) == pdPASS; }
+
+    // Format one line, the line feed is added
+    void printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char line[LINE_SIZE];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(line, sizeof(line) - 1, format, args);
+        va_end(args);
+        if (length < 0)
+            return;
+        if ((size_t)length > sizeof(line) - 2)
+            length = sizeof(line) - 2; // Cut off, room for the line feed
+        line[length++] = '\n';
+        push(line, length, false);
+    }
+
+    // Copy text of any length as one line, for payloads longer than LINE_SIZE
+    void println(const char *text, size_t length) { push(text, length, true); }
+
+    // Wait until the ring is on Serial, before a reboot or deep sleep
+    void flush(uint32_t timeoutMs = 1000)
+    {
+        unsigned long startTime = millis();
+        while (used() != 0 && millis() - startTime < timeoutMs)
+        {
+            if (task == NULL) // No drain task, drain from here
+                drain();
+            delay(1);
+        }
+        Serial.flush();
+    }
+
+private:
+    char buffer[SIZE];                                // Log text, head - tail bytes from tail on
+    size_t head = 0;                                  // Bytes ever written, producers only, under lock
+    size_t tail = 0;                                  // Bytes ever drained, drainer only
+    uint32_t dropped = 0;                             // Lines that found the ring full
+    uint32_t reportedDrops = 0;                       // dropped at the last drop report, drainer only
+    TaskHandle_t task = NULL;                         // Drain task, NULL before begin()
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED; // Guards head and tail, every task logs
+
+    size_t used()
+    {
+        portENTER_CRITICAL(&lock);
+        size_t length = head - tail;
+        portEXIT_CRITICAL(&lock);
+        return length;
+    }
+
+    // Move the ring to Serial as its transmit buffer frees up, never blocks
+    void drain()
+    {
+        while (true)
+        {
+            size_t room = Serial.availableForWrite();
+            size_t pending = used();
+            size_t offset = tail & (SIZE - 1);
+            size_t length = pending < SIZE - offset ? pending : SIZE - offset; // Up to the end of the ring
+            if (length > room)
+                length = room;
+            if (length == 0)
+                break;
+            Serial.write((const uint8_t *)buffer + offset, length); // Only the drainer writes tail, the text stays put
+            portENTER_CRITICAL(&lock);
+            tail += length;
+            portEXIT_CRITICAL(&lock);
+        }
+        if (dropped != reportedDrops) // Tell the reader lines are missing
+        {
+            reportedDrops = dropped;
+            printf("Log buffer full, %lu lines dropped", (unsigned long)reportedDrops);
+        }
+    }
+
+    void push(const char *text, size_t length, bool lineFeed)
+    {
+        size_t total = length + (lineFeed ? 1 : 0);
+        portENTER_CRITICAL(&lock);
+        if (SIZE - (head - tail) < total)
+        {
+            dropped++; // Whole lines only, a cut line would garble the next one
+        }
+        else
+        {
+            for (size_t i = 0; i < length; i++)
+                buffer[(head + i) & (SIZE - 1)] = text[i];
+            if (lineFeed)
+                buffer[(head + length) & (SIZE - 1)] = '\n';
+            head += total;
+        }
+        portEXIT_CRITICAL(&lock);
+    }
+
+    static void drainTask(void *parameter)
+    {
+        LogBuffer *self = static_cast<LogBuffer *>(parameter);
+        while (true)
+        {
+            self->drain();
+            vTaskDelay(pdMS_TO_TICKS(DRAIN_PERIOD_MS));
+        }
+    }
+};
+
+inline LogBuffer<LOG_BUFFER_SIZE> &logBuffer() // The one ring of the image
+{
+    static LogBuffer<LOG_BUFFER_SIZE> buffer;
+    return buffer;
+}
+
+#define LOG_BEGIN() logBuffer().begin()
+#define LOG_FLUSH() logBuffer().flush()
+#else
+#define LOG_BEGIN() ((void)0)
+#define LOG_FLUSH() ((void)0)
+#endif
+
+// * Logging macros, one call is one line
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logBuffer().printf(__VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) logBuffer().printf(__VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logBuffer().printf(__VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logBuffer().printf(__VA_ARGS__)
+#define LOG_DEBUG_TEXT(text, length) logBuffer().println(text, length) // Text longer than a printf() line
+#else
+#define LOG_DEBUG(...) ((void)0)
+#define LOG_DEBUG_TEXT(text, length) ((void)0)
+#endif
+
+#endif // Log_h
@@ -0,0 +1,108 @@
+// Metrics.h
+#ifndef Metrics_h
+#define Metrics_h
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+// Durations recorded by one timer since the previous takeLatency()
+struct LatencySummary
+{
+    uint32_t count;  // Durations recorded
+    uint32_t meanUs; // Average duration
+    uint32_t p90Us;  // 90th percentile, upper bound of its power-of-two bucket
+    uint32_t maxUs;  // Longest duration
+};
+
+// Runtime metrics of the hot paths: TIMERS latency histograms and COUNTERS event counters,
+// both indexed by the enums of the sketch.
+// record() finds the bucket from the leading zero count and adds a few words under a
+// spinlock, cheap enough for every sensor read and TLS write of any task.
+// Histograms collect power-of-two microsecond buckets until takeLatency() summarizes and
+// clears them; counters only grow, so the receiver computes rates across lost reports.
+template <size_t TIMERS, size_t COUNTERS>
+class Metrics
+{
+public:
+    static constexpr size_t BUCKETS = 25; // Bucket i holds 2^(i-1) to 2^i - 1 us, the last one everything from 8.4 s
+
+    // Add one duration to a timer
+    void record(size_t timer, uint32_t durationUs)
+    {
+        if (timer >= TIMERS)
+            return;
+        size_t bucket = durationUs == 0 ? 0 : 32 - __builtin_clz(durationUs);
+        if (bucket >= BUCKETS)
+            bucket = BUCKETS - 1;
+
+        portENTER_CRITICAL(&lock);
+        Histogram &histogram = histograms[timer];
+        histogram.buckets[bucket]++;
+        histogram.count++;
+        histogram.sumUs += durationUs;
+        if (durationUs > histogram.maxUs)
+            histogram.maxUs = durationUs;
+        portEXIT_CRITICAL(&lock);
+    }
+
+    // Add the time since startUs, taken from esp_timer_get_time(), to a timer
+    void recordSince(size_t timer, int64_t startUs) { record(timer, (uint32_t)(esp_timer_get_time() - startUs)); }
+
+    // Count events, such as a reconnect or a dropped sample
+    void increment(size_t index, uint32_t amount = 1)
+    {
+        if (index >= COUNTERS)
+            return;
+        portENTER_CRITICAL(&lock);
+        counters[index] += amount;
+        portEXIT_CRITICAL(&lock);
+    }
+
+    uint32_t counter(size_t index) const { return index < COUNTERS ? counters[index] : 0; } // Events since boot
+
+    // Summarize a timer since the previous call and start a new window
+    LatencySummary takeLatency(size_t timer)
+    {
+        LatencySummary summary = {};
+        if (timer >= TIMERS)
+            return summary;
+        portENTER_CRITICAL(&lock);
+        Histogram histogram = histograms[timer];
+        histograms[timer] = {};
+        portEXIT_CRITICAL(&lock);
+
+        summary.count = histogram.count;
+        if (histogram.count == 0)
+            return summary;
+        summary.meanUs = histogram.sumUs / histogram.count;
+        summary.maxUs = histogram.maxUs;
+        uint32_t rank = (histogram.count * 9 + 9) / 10; // Durations at or below the 90th percentile, rounded up
+        uint32_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++)
+        {
+            seen += histogram.buckets[i];
+            if (seen >= rank)
+            {
+                uint32_t upperUs = i == 0 ? 0 : (uint32_t)((1ull << i) - 1);
+                summary.p90Us = upperUs < histogram.maxUs ? upperUs : histogram.maxUs; // Never above the measured maximum
+                break;
+            }
+        }
+        return summary;
+    }
+
+private:
+    struct Histogram
+    {
+        uint32_t buckets[BUCKETS]; // Durations per power-of-two bucket
+        uint32_t count;            // Durations in the window
+        uint64_t sumUs;            // Sum of the durations in the window
+        uint32_t maxUs;            // Longest duration in the window
+    };
+
+    Histogram histograms[TIMERS] = {};                // Current window of every timer
+    uint32_t counters[COUNTERS] = {};                 // Counters since boot
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED; // Guards both, the tasks record concurrently
+};
+
+#endif // Metrics_h
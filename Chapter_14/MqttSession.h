@@ -0,0 +1,416 @@
+// MqttSession.h
+#ifndef MqttSession_h
+#define MqttSession_h
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+
+// MQTT 3.1.1 client session over an already connected Transport, a WiFiClientSecure opened
+// with connectAsync() or a class derived from it. Publishes with QoS 0, or with QoS 1 through a window of up to
+// WINDOW unacknowledged PUBLISHes, so several messages travel per round trip.
+// Each QoS 1 publish carries a caller token, such as the last ring sequence of the batch;
+// takeConfirmed() hands the tokens back in publish order once every PUBLISH up to them is
+// acknowledged, so the caller only commits what the broker holds. loop() reads PUBACKs
+// and PINGRESPs without blocking and sends the keep-alive PINGREQ. A PUBACK or PINGRESP
+// that stays out too long closes the connection, the caller reconnects and resends from
+// its last commit; delivery is at least once.
+// A PUBLISH goes out as one writev() of two segments, the header built here and the caller
+// payload in place, so both share one TLS record and the payload is never copied into a
+// packet buffer of the session.
+// subscribe() asks for QoS 0 messages; an incoming PUBLISH of up to INBOUND_SIZE bytes of
+// topic and payload is handed to the callback from loop(), a longer one is skipped.
+template <size_t WINDOW, typename Transport, size_t INBOUND_SIZE = 0>
+class MqttSession
+{
+public:
+    // Values of state(), the same codes as PubSubClient, 1 to 5 are CONNACK return codes
+    static constexpr int CONNECTION_TIMEOUT = -4; // No CONNACK, PUBACK or PINGRESP in time
+    static constexpr int CONNECTION_LOST = -3;    // The client closed or a write failed
+    static constexpr int CONNECT_FAILED = -2;     // The CONNECT packet could not be sent
+    static constexpr int DISCONNECTED = -1;       // disconnect() or never connected
+    static constexpr int CONNECTED = 0;           // Session up
+
+    static constexpr uint32_t CONNACK_TIMEOUT_MS = 5000;  // Longest wait for CONNACK in connect()
+    static constexpr uint32_t PUBACK_TIMEOUT_MS = 10000; // Longest wait for the PUBACK of the oldest PUBLISH
+
+    typedef void (*MessageCallback)(const char *topic, const uint8_t *payload, size_t length); // Incoming PUBLISH
+
+    explicit MqttSession(Transport &client) : client(client) {}
+
+    void setCallback(MessageCallback callback) { messageCallback = callback; } // Receiver of incoming PUBLISHes
+
+    // Send CONNECT on the open connection and wait for CONNACK, with a clean session
+    bool connect(const char *clientId, uint16_t keepAliveS)
+    {
+        resetSession();
+        keepAliveMs = (uint32_t)keepAliveS * 1000;
+        if (!client.connected())
+        {
+            sessionState = CONNECTION_LOST;
+            return false;
+        }
+
+        if (strlen(clientId) + 12 > HEADER_SIZE - HEADER_RESERVE)
+        {
+            sessionState = CONNECT_FAILED;
+            return false;
+        }
+        uint8_t *body = header + HEADER_RESERVE;
+        size_t length = 0;
+        length += putString(body + length, "MQTT");
+        body[length++] = 4;                // Protocol level 3.1.1
+        body[length++] = 0x02;             // Clean session, no will, no user name
+        body[length++] = keepAliveS >> 8;  // Keep alive, most significant byte first
+        body[length++] = keepAliveS & 0xFF;
+        length += putString(body + length, clientId);
+        if (!sendPacket(0x10, length, NULL, 0)) // CONNECT
+        {
+            sessionState = CONNECT_FAILED;
+            return false;
+        }
+
+        connackCode = -1;
+        unsigned long startTime = millis();
+        while (connackCode < 0 && millis() - startTime < CONNACK_TIMEOUT_MS && client.connected())
+        {
+            readPackets();
+            delay(1);
+        }
+        if (connackCode != 0)
+        {
+            sessionState = connackCode < 0 ? CONNECTION_TIMEOUT : connackCode;
+            client.stop();
+            return false;
+        }
+        sessionState = CONNECTED;
+        lastInboundTime = millis();
+        return true;
+    }
+
+    // Session up and the connection still open
+    bool connected()
+    {
+        if (sessionState == CONNECTED && !client.connected())
+            drop(CONNECTION_LOST);
+        return sessionState == CONNECTED;
+    }
+
+    // Send DISCONNECT and close the connection, unacknowledged PUBLISHes are forgotten
+    void disconnect()
+    {
+        if (connected())
+        {
+            uint8_t disconnect[] = {0xE0, 0x00};
+            client.write(disconnect, sizeof(disconnect));
+        }
+        drop(DISCONNECTED);
+    }
+
+    int state() const { return sessionState; } // Last connection state, see the codes above
+
+    // Read incoming packets, send the keep-alive and time out a silent broker, never blocks
+    void loop()
+    {
+        if (!connected())
+            return;
+        readPackets();
+
+        unsigned long currentMillis = millis();
+        for (size_t i = 0; i < pendingCount; i++) // Acknowledged slots only wait for takeConfirmed()
+        {
+            const InFlight &slot = slots[(oldestSlot + i) % WINDOW];
+            if (slot.isAcked)
+                continue;
+            if (currentMillis - slot.sentTime >= PUBACK_TIMEOUT_MS)
+            {
+                drop(CONNECTION_TIMEOUT); // The broker or the path is gone, resend on a new session
+                return;
+            }
+            break; // Later PUBLISHes were sent after this one
+        }
+        if (isPingPending)
+        {
+            if (currentMillis - lastInboundTime >= keepAliveMs)
+                drop(CONNECTION_TIMEOUT);
+            return;
+        }
+        if (keepAliveMs != 0 && (currentMillis - lastOutboundTime >= keepAliveMs || currentMillis - lastInboundTime >= keepAliveMs))
+        {
+            uint8_t ping[] = {0xC0, 0x00}; // PINGREQ
+            if (write(ping, sizeof(ping)))
+            {
+                isPingPending = true;
+                lastInboundTime = currentMillis; // Start of the PINGRESP wait
+            }
+        }
+    }
+
+    // Publish with QoS 0, returns true once the PUBLISH is written
+    bool publish(const char *topic, const uint8_t *payload, size_t length) { return sendPublish(topic, payload, length, 0); }
+
+    // Publish with QoS 1, returns false if the window is full, the topic does not fit or the write fails
+    bool publishConfirmed(const char *topic, const uint8_t *payload, size_t length, uint32_t token)
+    {
+        if (!canPublishConfirmed())
+            return false;
+        uint16_t packetId = nextPacketId;
+        nextPacketId = nextPacketId == 0xFFFF ? 1 : nextPacketId + 1; // 0 is not a valid identifier
+        if (!sendPublish(topic, payload, length, packetId))
+            return false;
+
+        InFlight &slot = slots[(oldestSlot + pendingCount) % WINDOW];
+        slot.packetId = packetId;
+        slot.token = token;
+        slot.sentTime = millis();
+        slot.isAcked = false;
+        pendingCount++;
+        return true;
+    }
+
+    // Subscribe to a topic filter with QoS 0, the SUBACK is not waited for
+    bool subscribe(const char *topic)
+    {
+        if (!connected() || HEADER_RESERVE + 2 + 2 + strlen(topic) + 1 > HEADER_SIZE)
+            return false;
+        uint8_t *body = header + HEADER_RESERVE;
+        uint16_t packetId = nextPacketId;
+        nextPacketId = nextPacketId == 0xFFFF ? 1 : nextPacketId + 1;
+        body[0] = packetId >> 8;
+        body[1] = packetId & 0xFF;
+        size_t length = 2 + putString(body + 2, topic);
+        body[length++] = 0; // Requested QoS
+        return sendPacket(0x82, length, NULL, 0); // SUBSCRIBE
+    }
+
+    bool canPublishConfirmed() { return connected() && pendingCount < WINDOW; } // Room in the window
+    size_t inFlight() const { return pendingCount; }                             // QoS 1 PUBLISHes not yet handed back
+
+    // Hand back the token of the oldest PUBLISH once it and every older one are acknowledged
+    bool takeConfirmed(uint32_t &token)
+    {
+        if (pendingCount == 0 || !slots[oldestSlot].isAcked)
+            return false;
+        token = slots[oldestSlot].token;
+        oldestSlot = (oldestSlot + 1) % WINDOW;
+        pendingCount--;
+        return true;
+    }
+
+private:
+    static constexpr size_t HEADER_RESERVE = 5; // Fixed header room in front of the body, type and up to 4 length bytes
+    static constexpr size_t HEADER_SIZE = 128;  // A whole CONNECT, or a PUBLISH up to its payload
+    static constexpr size_t RX_BODY_SIZE = INBOUND_SIZE > 4 ? INBOUND_SIZE : 4; // Kept body bytes, at least a CONNACK or PUBACK
+
+    // One unacknowledged QoS 1 PUBLISH
+    struct InFlight
+    {
+        uint16_t packetId;      // Packet identifier the PUBACK refers to
+        uint32_t token;         // Caller token handed back by takeConfirmed()
+        unsigned long sentTime; // millis() when written
+        bool isAcked;           // PUBACK received, waiting for the older ones
+    };
+
+    // Position of the incoming packet parser
+    enum RxState
+    {
+        RxHeader, // Next byte is a packet type
+        RxLength, // Reading the remaining length
+        RxBody    // Reading the packet body
+    };
+
+    Transport &client;                      // Open TLS connection to the broker
+    uint8_t header[HEADER_SIZE];            // Outgoing packet up to the payload, fixed header written in front of the body
+    InFlight slots[WINDOW] = {};            // Window in publish order, from oldestSlot on
+    size_t oldestSlot = 0;                  // Slot of the oldest unacknowledged PUBLISH
+    size_t pendingCount = 0;                // Slots in use
+    uint16_t nextPacketId = 1;              // Identifier of the next QoS 1 PUBLISH
+    int sessionState = DISCONNECTED;        // Returned by state()
+    int connackCode = -1;                   // CONNACK return code, -1 until it arrives
+    uint32_t keepAliveMs = 0;               // Keep alive from connect()
+    unsigned long lastOutboundTime = 0;     // Last packet written
+    unsigned long lastInboundTime = 0;      // Last packet read, or the PINGREQ while one is pending
+    bool isPingPending = false;             // PINGREQ sent, no PINGRESP yet
+    uint8_t rxType = 0;                     // Type and flags of the packet being read
+    uint32_t rxLength = 0;                  // Remaining length of the packet being read
+    uint8_t rxShift = 0;                    // Next remaining length digit position
+    uint32_t rxCount = 0;                   // Body bytes read
+    uint8_t rxBody[RX_BODY_SIZE] = {};      // First body bytes, CONNACK, PUBACK or an incoming PUBLISH
+    MessageCallback messageCallback = NULL; // Receiver of incoming PUBLISHes
+    RxState rxState = RxHeader;             // Incoming packet parser state
+
+    void resetSession()
+    {
+        pendingCount = 0;
+        isPingPending = false;
+        rxState = RxHeader;
+    }
+
+    void drop(int reason)
+    {
+        client.stop();
+        resetSession(); // Nothing unacknowledged reaches takeConfirmed(), the caller resends
+        sessionState = reason;
+    }
+
+    static size_t putString(uint8_t *out, const char *text)
+    {
+        size_t length = strlen(text);
+        out[0] = length >> 8;
+        out[1] = length & 0xFF;
+        memcpy(out + 2, text, length);
+        return length + 2;
+    }
+
+    bool write(const uint8_t *data, size_t length)
+    {
+        if (client.write(data, length) != length)
+        {
+            drop(CONNECTION_LOST);
+            return false;
+        }
+        lastOutboundTime = millis();
+        return true;
+    }
+
+    // Write the fixed header in front of the body at header + HEADER_RESERVE, then send it and
+    // the payload in one writev()
+    bool sendPacket(uint8_t type, size_t bodyLength, const uint8_t *payload, size_t payloadLength)
+    {
+        uint8_t lengthBytes[4];
+        size_t lengthCount = 0;
+        size_t remaining = bodyLength + payloadLength;
+        do
+        {
+            uint8_t digit = remaining % 128;
+            remaining /= 128;
+            lengthBytes[lengthCount++] = remaining > 0 ? digit | 0x80 : digit;
+        } while (remaining > 0 && lengthCount < sizeof(lengthBytes));
+
+        uint8_t *start = header + HEADER_RESERVE - 1 - lengthCount;
+        start[0] = type;
+        memcpy(start + 1, lengthBytes, lengthCount);
+        tls_segment_t segments[] = {{start, 1 + lengthCount + bodyLength}, {payload, payloadLength}};
+        size_t length = segments[0].size + payloadLength;
+        if (client.writev(segments, payloadLength > 0 ? 2 : 1) != length)
+        {
+            drop(CONNECTION_LOST);
+            return false;
+        }
+        lastOutboundTime = millis();
+        return true;
+    }
+
+    bool sendPublish(const char *topic, const uint8_t *payload, size_t length, uint16_t packetId)
+    {
+        size_t topicLength = strlen(topic);
+        if (!connected() || HEADER_RESERVE + 2 + topicLength + 2 > HEADER_SIZE)
+            return false;
+
+        uint8_t *body = header + HEADER_RESERVE;
+        size_t offset = putString(body, topic);
+        if (packetId != 0)
+        {
+            body[offset++] = packetId >> 8;
+            body[offset++] = packetId & 0xFF;
+        }
+        return sendPacket(packetId != 0 ? 0x32 : 0x30, offset, payload, length); // PUBLISH, QoS 1 or QoS 0
+    }
+
+    void readPackets()
+    {
+        uint8_t chunk[64];
+        while (true) // read() decrypts straight into chunk, -1 once nothing is left
+        {
+            int count = client.read(chunk, sizeof(chunk));
+            if (count <= 0)
+                return;
+            for (int i = 0; i < count; i++)
+                parse(chunk[i]);
+        }
+    }
+
+    void parse(uint8_t value)
+    {
+        switch (rxState)
+        {
+        case RxHeader:
+            rxType = value;
+            rxLength = 0;
+            rxShift = 0;
+            rxState = RxLength;
+            break;
+        case RxLength:
+            rxLength |= (uint32_t)(value & 0x7F) << rxShift;
+            rxShift += 7;
+            if (value & 0x80)
+            {
+                if (rxShift > 21) // More than 4 length bytes, the stream is out of sync
+                    drop(CONNECTION_LOST);
+                break;
+            }
+            rxCount = 0;
+            rxState = RxBody;
+            if (rxLength == 0)
+                finishPacket();
+            break;
+        case RxBody:
+            if (rxCount < sizeof(rxBody))
+                rxBody[rxCount] = value;
+            rxCount++;
+            if (rxCount == rxLength)
+                finishPacket();
+            break;
+        }
+    }
+
+    // Act on a complete incoming packet, anything but CONNACK, PUBLISH, PUBACK and PINGRESP is skipped
+    void finishPacket()
+    {
+        rxState = RxHeader;
+        lastInboundTime = millis();
+        switch (rxType >> 4)
+        {
+        case 2: // CONNACK
+            if (rxLength >= 2)
+                connackCode = rxBody[1];
+            break;
+        case 3: // PUBLISH, QoS 0 as subscribed
+            if (rxLength <= sizeof(rxBody) && (rxType & 0x06) == 0)
+                deliver();
+            break;
+        case 4: // PUBACK
+            if (rxLength >= 2)
+                acknowledge((rxBody[0] << 8) | rxBody[1]);
+            break;
+        case 13: // PINGRESP
+            isPingPending = false;
+            break;
+        }
+    }
+
+    // Hand the PUBLISH in rxBody to the callback, the topic moved down over its length bytes for its terminator
+    void deliver()
+    {
+        size_t topicLength = (rxBody[0] << 8) | rxBody[1];
+        if (messageCallback == NULL || 2 + topicLength > rxLength)
+            return;
+        memmove(rxBody, rxBody + 2, topicLength);
+        rxBody[topicLength] = 0;
+        messageCallback((const char *)rxBody, rxBody + 2 + topicLength, rxLength - 2 - topicLength);
+    }
+
+    void acknowledge(uint16_t packetId)
+    {
+        for (size_t i = 0; i < pendingCount; i++)
+        {
+            InFlight &slot = slots[(oldestSlot + i) % WINDOW];
+            if (slot.packetId == packetId)
+            {
+                slot.isAcked = true;
+                return;
+            }
+        }
+    }
+};
+
+#endif // MqttSession_h
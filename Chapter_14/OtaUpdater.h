@@ -0,0 +1,392 @@
+// OtaUpdater.h
+#ifndef OtaUpdater_h
+#define OtaUpdater_h
+
+#include <Arduino.h>
+#include <atomic>
+#include <Update.h>
+#include <WiFiClientSecure.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/sha256.h>
+
+constexpr size_t OTA_JOB_ID_SIZE = 65;    // AWS IoT job IDs have at most 64 characters
+constexpr size_t OTA_URL_SIZE = 2048;     // Room for a presigned S3 URL with its session token
+constexpr size_t OTA_SIGNATURE_SIZE = 80; // DER ECDSA P-256 signature, at most 72 bytes
+
+// One firmware update, taken from the job document of an AWS IoT job
+struct OtaJob
+{
+    char jobId[OTA_JOB_ID_SIZE];           // Job the status updates refer to
+    char url[OTA_URL_SIZE];                // HTTPS URL of the image, such as a presigned S3 URL
+    uint32_t size;                         // Size of the resulting firmware image in bytes
+    char baseMd5[33];                      // ESP.getSketchMD5() a delta image applies to, empty for a full image
+    uint8_t signature[OTA_SIGNATURE_SIZE]; // ECDSA signature of the SHA-256 of the resulting image, DER
+    size_t signatureLength;                // Bytes used in signature
+};
+
+// State of the updater, see state()
+enum OtaState : uint8_t
+{
+    OtaIdle,    // No update, start() may be called
+    OtaRunning, // Downloading and writing in the OTA task
+    OtaReady,   // Image verified and set as the boot partition, waiting for the restart
+    OtaFailed,  // Update abandoned, see failureReason(), clear() makes room for the next one
+};
+
+// Streams a signed firmware image over HTTPS into the inactive OTA partition with Update.write(),
+// CHUNK_SIZE bytes at a time, in its own task so sampling and telemetry go on meanwhile.
+// The image is never held in RAM. A dropped connection is resumed with an HTTP Range request
+// from the first byte not yet consumed, which for a full image is the flash offset
+// Update.progress(); MAX_ATTEMPTS connections in a row without progress abandon the update.
+// A restart in the middle starts over, the Update library cannot continue a partial image.
+// A delta image rebuilds the new image from the running one, whose ESP.getSketchMD5() must
+// match the job. It is a stream of commands, numbers little-endian:
+//   'C' offset:u32 length:u32 copy length bytes of the running image from offset
+//   'I' length:u32 bytes      insert the length bytes that follow
+// until the image has its announced size. The SHA-256 of the resulting image must verify
+// against the ECDSA signature of the job with the public key of begin(), otherwise the
+// partition is not made bootable.
+class OtaUpdater
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 1024;         // Bytes read from TLS and written per step
+    static constexpr size_t COPY_SIZE = 256;           // Bytes read from the running image per step of a delta copy
+    static constexpr uint32_t STACK_SIZE = 8192;       // Task stack, the TLS handshake and one chunk included
+    static constexpr uint8_t MAX_ATTEMPTS = 5;         // Connections in a row without progress before giving up
+    static constexpr uint32_t RETRY_DELAY_MS = 5000;   // Wait before resuming a dropped download
+    static constexpr uint32_t READ_TIMEOUT_MS = 15000; // Longest silence of the server before the connection is dropped
+
+    // client must be set up with the CA of the image host
+    explicit OtaUpdater(WiFiClientSecure &client) : client(client) { mbedtls_pk_init(&publicKey); }
+
+    // Parse the PEM public key the images are signed with, returns false if it is no EC key
+    bool begin(const char *publicKeyPem)
+    {
+        isKeyLoaded = mbedtls_pk_parse_public_key(&publicKey, (const unsigned char *)publicKeyPem, strlen(publicKeyPem) + 1) == 0 &&
+                      mbedtls_pk_can_do(&publicKey, MBEDTLS_PK_ECKEY);
+        return isKeyLoaded;
+    }
+
+    // Start the update in its own task on core, returns false without a key or while an update runs.
+    // The job must stay unchanged until the update is ready or failed.
+    bool start(const OtaJob &newJob, UBaseType_t priority, BaseType_t core = tskNO_AFFINITY)
+    {
+        OtaState current = state();
+        if (!isKeyLoaded || current == OtaRunning || current == OtaReady)
+            return false;
+        job = &newJob;
+        written.store(0);
+        currentState.store(OtaRunning);
+        if (xTaskCreatePinnedToCore(updateTask, "ota", STACK_SIZE, this, priority, NULL, core) != pdPASS)
+        {
+            fail("No memory for the OTA task");
+            return false;
+        }
+        return true;
+    }
+
+    OtaState state() const { return (OtaState)currentState.load(); } // Current state, written by the OTA task
+    uint32_t progress() const { return written.load(); }             // Image bytes passed to Update.write()
+    const char *failureReason() const { return failure; }             // Why the last update failed
+    void clear()                                                      // Take note of a failure, the next start() may run
+    {
+        if (state() == OtaFailed)
+            currentState.store(OtaIdle);
+    }
+
+private:
+    // Position of the delta decoder
+    enum DeltaState
+    {
+        DeltaCommand,   // Next byte is a command
+        DeltaArguments, // Reading the offset and length of a command
+        DeltaLiteral    // Reading the bytes of an insert
+    };
+
+    WiFiClientSecure &client;                   // TLS connection to the image host, OTA task only
+    const OtaJob *job = NULL;                   // Update being run
+    mbedtls_pk_context publicKey;               // Key the image signatures verify with
+    bool isKeyLoaded = false;                   // begin() parsed an EC key
+    std::atomic<uint8_t> currentState{OtaIdle}; // OtaState, loads and stores only as the ESP32-C3 has no atomic read-modify-write
+    std::atomic<uint32_t> written{0};           // Image bytes written, OTA task only writes it
+    const char *failure = "";                   // Set before currentState becomes OtaFailed
+    const char *fatal = NULL;                   // Error the update cannot continue after, resuming would not help
+    uint32_t received = 0;                      // Download bytes consumed, where a resumed request starts
+    mbedtls_sha256_context sha;                 // Hash of the image as written
+    const esp_partition_t *base = NULL;         // Running image, the source of delta copies
+    DeltaState deltaState = DeltaCommand;       // Delta decoder state
+    uint8_t command = 0;                        // Delta command being decoded
+    uint8_t arguments[8] = {};                  // Offset and length of the command, as received
+    size_t argumentCount = 0;                   // Argument bytes received
+    uint32_t literalRemaining = 0;              // Bytes of the insert still to come
+
+    static void updateTask(void *parameter)
+    {
+        static_cast<OtaUpdater *>(parameter)->run();
+        vTaskDelete(NULL); // One task per update
+    }
+
+    void fail(const char *reason)
+    {
+        failure = reason;
+        currentState.store(OtaFailed);
+    }
+
+    void run()
+    {
+        bool isDelta = job->baseMd5[0] != 0;
+        if (isDelta && !ESP.getSketchMD5().equalsIgnoreCase(job->baseMd5))
+            return fail("Delta base is not the running image");
+        base = esp_ota_get_running_partition();
+        if (!Update.begin(job->size))
+            return fail(Update.errorString());
+
+        mbedtls_sha256_init(&sha);
+        mbedtls_sha256_starts(&sha, 0);
+        received = 0;
+        fatal = NULL;
+        deltaState = DeltaCommand;
+        for (uint8_t attempt = 0; attempt < MAX_ATTEMPTS && written.load() < job->size && fatal == NULL; attempt++)
+        {
+            if (attempt > 0)
+                vTaskDelay(pdMS_TO_TICKS(RETRY_DELAY_MS));
+            uint32_t before = received;
+            download();
+            client.stop();
+            if (received != before)
+                attempt = 0; // Progress, the next connection resumes after a fresh set of attempts
+        }
+
+        uint8_t hash[32];
+        mbedtls_sha256_finish(&sha, hash);
+        mbedtls_sha256_free(&sha);
+        if (fatal != NULL || written.load() < job->size)
+        {
+            Update.abort();
+            return fail(fatal != NULL ? fatal : "Download failed");
+        }
+        if (mbedtls_pk_verify(&publicKey, MBEDTLS_MD_SHA256, hash, sizeof(hash), job->signature, job->signatureLength) != 0)
+        {
+            Update.abort();
+            return fail("Signature check failed");
+        }
+        if (!Update.end())
+            return fail(Update.errorString());
+        currentState.store(OtaReady);
+    }
+
+    // One HTTPS GET from the first byte not yet consumed, until the image is complete or the connection ends
+    void download()
+    {
+        char host[128];
+        uint16_t port;
+        const char *path;
+        if (!parseUrl(job->url, host, sizeof(host), port, path))
+        {
+            fatal = "Unsupported image URL, only https:// is";
+            return;
+        }
+        if (!client.connect(host, port))
+            return;
+
+        char range[16];
+        snprintf(range, sizeof(range), "%lu", (unsigned long)received);
+        const char *parts[] = {"GET ", path, " HTTP/1.1\r\nHost: ", host, "\r\nRange: bytes=", range, "-\r\nConnection: close\r\n\r\n"};
+        tls_segment_t segments[sizeof(parts) / sizeof(parts[0])];
+        size_t length = 0;
+        for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++)
+        {
+            segments[i] = {(const uint8_t *)parts[i], strlen(parts[i])};
+            length += segments[i].size;
+        }
+        if (client.writev(segments, sizeof(segments) / sizeof(segments[0])) != length) // The request in one TLS record
+            return;
+
+        char line[128];
+        int status = 0;
+        if (!readLine(line, sizeof(line)) || sscanf(line, "HTTP/%*s %d", &status) != 1)
+            return;
+        while (readLine(line, sizeof(line)) && line[0] != 0) // Skip the headers, the job announced the size
+            ;
+        if (status != 206 && status != 200)
+        {
+            fatal = status == 403 ? "Image URL refused or expired" : "Image request failed";
+            return;
+        }
+        uint32_t skip = status == 200 ? received : 0; // The whole file without the range, throw the consumed part away
+
+        uint8_t chunk[CHUNK_SIZE];
+        unsigned long lastDataTime = millis();
+        while (written.load() < job->size && fatal == NULL)
+        {
+            int count = client.read(chunk, sizeof(chunk));
+            if (count <= 0)
+            {
+                if (!client.connected() || millis() - lastDataTime >= READ_TIMEOUT_MS)
+                    return;
+                vTaskDelay(1);
+                continue;
+            }
+            lastDataTime = millis();
+            size_t offset = 0;
+            if (skip > 0)
+            {
+                offset = skip < (uint32_t)count ? skip : count;
+                skip -= offset;
+            }
+            consume(chunk + offset, count - offset);
+        }
+    }
+
+    // Read one header line without its line end, a longer line is cut off; false on timeout or close
+    bool readLine(char *line, size_t size)
+    {
+        size_t length = 0;
+        unsigned long startTime = millis();
+        while (millis() - startTime < READ_TIMEOUT_MS)
+        {
+            int value = client.read();
+            if (value < 0)
+            {
+                if (!client.connected())
+                    return false;
+                vTaskDelay(1);
+                continue;
+            }
+            if (value == '\n')
+            {
+                line[length] = 0;
+                return true;
+            }
+            if (value != '\r' && length < size - 1)
+                line[length++] = value;
+        }
+        return false;
+    }
+
+    // Feed download bytes to the image, through the delta decoder for a delta image
+    void consume(const uint8_t *data, size_t length)
+    {
+        received += length;
+        if (job->baseMd5[0] == 0)
+        {
+            emit(data, length);
+            return;
+        }
+        while (length > 0 && fatal == NULL)
+        {
+            switch (deltaState)
+            {
+            case DeltaCommand:
+                command = *data++;
+                length--;
+                if (command != 'C' && command != 'I')
+                    fatal = "Corrupt delta image";
+                argumentCount = 0;
+                deltaState = DeltaArguments;
+                break;
+            case DeltaArguments:
+            {
+                size_t needed = command == 'C' ? 8 : 4;
+                size_t count = needed - argumentCount < length ? needed - argumentCount : length;
+                memcpy(arguments + argumentCount, data, count);
+                argumentCount += count;
+                data += count;
+                length -= count;
+                if (argumentCount < needed)
+                    break;
+                if (command == 'C')
+                {
+                    copyFromBase(readLe32(arguments), readLe32(arguments + 4));
+                    deltaState = DeltaCommand;
+                }
+                else
+                {
+                    literalRemaining = readLe32(arguments);
+                    deltaState = literalRemaining > 0 ? DeltaLiteral : DeltaCommand;
+                }
+                break;
+            }
+            case DeltaLiteral:
+            {
+                size_t count = literalRemaining < length ? literalRemaining : length;
+                emit(data, count);
+                data += count;
+                length -= count;
+                literalRemaining -= count;
+                if (literalRemaining == 0)
+                    deltaState = DeltaCommand;
+                break;
+            }
+            }
+        }
+    }
+
+    // Copy a span of the running image into the new one
+    void copyFromBase(uint32_t offset, uint32_t length)
+    {
+        if (base == NULL || offset > base->size || length > base->size - offset)
+        {
+            fatal = "Delta copy outside the running image";
+            return;
+        }
+        uint8_t buffer[COPY_SIZE];
+        while (length > 0 && fatal == NULL)
+        {
+            size_t count = length < sizeof(buffer) ? length : sizeof(buffer);
+            if (esp_partition_read(base, offset, buffer, count) != ESP_OK)
+            {
+                fatal = "Running image unreadable";
+                return;
+            }
+            emit(buffer, count);
+            offset += count;
+            length -= count;
+        }
+    }
+
+    // Write image bytes to the OTA partition and the hash
+    void emit(const uint8_t *data, size_t length)
+    {
+        uint32_t total = written.load();
+        if (length > job->size - total)
+        {
+            fatal = "Image longer than announced";
+            return;
+        }
+        if (Update.write(const_cast<uint8_t *>(data), length) != length)
+        {
+            fatal = Update.errorString();
+            return;
+        }
+        mbedtls_sha256_update(&sha, data, length);
+        written.store(total + length);
+    }
+
+    static uint32_t readLe32(const uint8_t *bytes) { return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24); }
+
+    // Split https://host[:port]/path into its parts, path points into url
+    static bool parseUrl(const char *url, char *host, size_t hostSize, uint16_t &port, const char *&path)
+    {
+        if (strncmp(url, "https://", 8) != 0)
+            return false;
+        const char *start = url + 8;
+        size_t length = strcspn(start, ":/?");
+        if (length == 0 || length >= hostSize)
+            return false;
+        memcpy(host, start, length);
+        host[length] = 0;
+        const char *end = start + length;
+        port = 443;
+        if (*end == ':')
+        {
+            port = atoi(end + 1);
+            end += strcspn(end, "/?");
+        }
+        path = *end == '/' ? end : "/";
+        return port != 0;
+    }
+};
+
+#endif // OtaUpdater_h
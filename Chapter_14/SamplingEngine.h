@@ -0,0 +1,114 @@
+// SamplingEngine.h
+#ifndef SamplingEngine_h
+#define SamplingEngine_h
+
+#include <Arduino.h>
+#include <math.h>
+
+// Report-by-exception settings of one measured quantity
+struct SamplingChannelConfig
+{
+    float deadband;       // Smallest change from the last report that is reported again
+    float rateThreshold;  // Change per second that counts as a transition and speeds up sampling
+    float lowBoundary;    // Lower threshold of the application, crossing it is always reported
+    float highBoundary;   // Upper threshold of the application, crossing it is always reported
+    float boundaryMargin; // Distance to a boundary within which sampling runs at the fast interval
+};
+
+// Sampling cadence shared by all quantities of one sensor
+struct SamplingTiming
+{
+    uint32_t slowIntervalMs; // Interval while every quantity is stable and away from its boundaries
+    uint32_t fastIntervalMs; // Interval near a boundary or during a transition
+    uint32_t heartbeatMs;    // Longest time between two reports, 0 disables the heartbeat
+};
+
+// Adaptive sampling and report-by-exception for a sensor with N quantities read together,
+// such as temperature and humidity of one DHT11 transaction.
+// Feed every sample to update(); it returns true when the sample should be reported, that is
+// when a quantity moved by its deadband, crossed a boundary, became valid or invalid, or the
+// heartbeat is due. intervalMs() tells when to take the next sample.
+template <size_t N>
+class SamplingEngine
+{
+public:
+    SamplingEngine(const SamplingChannelConfig (&channelConfigs)[N], const SamplingTiming &timing) : timing(timing)
+    {
+        for (size_t i = 0; i < N; i++)
+            channels[i] = channelConfigs[i];
+    }
+
+    // Feed one sample taken at nowMs, NAN marks a quantity the sensor did not deliver
+    bool update(const float (&values)[N], uint32_t nowMs)
+    {
+        bool changed = !hasReport;
+        bool fast = false;
+        for (size_t i = 0; i < N; i++)
+        {
+            const SamplingChannelConfig &config = channels[i];
+            float value = values[i];
+
+            // Transition: the value moves faster than rateThreshold since the previous sample
+            if (hasSample && !isnan(value) && !isnan(lastSample[i]) && nowMs != lastSampleMs)
+            {
+                float rate = fabsf(value - lastSample[i]) * 1000.0f / (nowMs - lastSampleMs);
+                fast |= rate >= config.rateThreshold;
+            }
+            fast |= isNearBoundary(config, value);
+
+            // Change: beyond the deadband, into another region, or between valid and invalid
+            float reported = lastReport[i];
+            if (isnan(value) != isnan(reported))
+                changed = true;
+            else if (!isnan(value) && (fabsf(value - reported) >= config.deadband || region(config, value) != region(config, reported)))
+                changed = true;
+
+            lastSample[i] = value;
+        }
+        hasSample = true;
+        lastSampleMs = nowMs;
+        isFast = fast;
+
+        bool heartbeat = timing.heartbeatMs != 0 && nowMs - lastReportMs >= timing.heartbeatMs;
+        if (!changed && !heartbeat)
+        {
+            suppressed++;
+            return false;
+        }
+
+        for (size_t i = 0; i < N; i++)
+            lastReport[i] = values[i];
+        hasReport = true;
+        lastReportMs = nowMs;
+        return true;
+    }
+
+    uint32_t intervalMs() const { return isFast ? timing.fastIntervalMs : timing.slowIntervalMs; } // Delay until the next sample
+    bool isFastSampling() const { return isFast; }                                                  // True near a boundary or during a transition
+    uint32_t suppressedSamples() const { return suppressed; }                                       // Samples not reported since boot
+
+private:
+    SamplingChannelConfig channels[N];          // Per quantity settings
+    const SamplingTiming timing;                // Sampling cadence
+    float lastSample[N] = {};                   // Previous sample, for the rate of change
+    float lastReport[N] = {};                   // Values of the last report, for the deadband
+    uint32_t lastSampleMs = 0;                  // Time of the previous sample
+    uint32_t lastReportMs = 0;                  // Time of the last report, for the heartbeat
+    uint32_t suppressed = 0;                    // Samples update() kept back
+    bool hasSample = false;                     // lastSample is valid
+    bool hasReport = false;                     // lastReport is valid
+    bool isFast = false;                        // The last sample asked for the fast interval
+
+    // 0 below the low boundary, 1 between the boundaries, 2 above the high boundary
+    static int region(const SamplingChannelConfig &config, float value)
+    {
+        return value < config.lowBoundary ? 0 : value > config.highBoundary ? 2 : 1;
+    }
+
+    static bool isNearBoundary(const SamplingChannelConfig &config, float value)
+    {
+        return !isnan(value) && (fabsf(value - config.lowBoundary) <= config.boundaryMargin || fabsf(value - config.highBoundary) <= config.boundaryMargin);
+    }
+};
+
+#endif // SamplingEngine_h
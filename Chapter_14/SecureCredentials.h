@@ -21,3 +21,30 @@ static const char AWS_PRIVATE_KEY[] PROGMEM = R"EOF(
 // Put your private key here.
 -----END RSA PRIVATE KEY-----
 )EOF";
+
+#if AWS_CREDENTIALS_DER
+// DER form of the same credentials, parsed in place from flash without a PEM copy on the heap
+// Convert with: openssl x509 -in <file>.pem -outform der | xxd -i
+static const uint8_t AWS_ROOT_CA_DER[] PROGMEM = {
+    0x30 // Put AmazonRootCA1 in DER here
+};
+
+// Device Certificate DER
+static const uint8_t AWS_CERT_CRT_DER[] PROGMEM = {
+    0x30 // Put your device certificate in DER here
+};
+
+// Device Private Key DER, convert with: openssl pkey -in <file>.pem.key -outform der | xxd -i
+static const uint8_t AWS_PRIVATE_KEY_DER[] PROGMEM = {
+    0x30 // Put your private key in DER here
+};
+#endif
+
+// Public key the firmware images of AWS IoT jobs are signed with, ECDSA P-256 (OTA_ENABLED)
+// Create the pair with: openssl ecparam -name prime256v1 -genkey -noout -out ota.key && openssl ec -in ota.key -pubout
+// Sign an image with: openssl dgst -sha256 -sign ota.key firmware.bin | base64 -w0
+static const char OTA_SIGNING_PUBLIC_KEY[] PROGMEM = R"EOF(
+-----BEGIN PUBLIC KEY-----
+// Put the public key of your firmware signing key here
+-----END PUBLIC KEY-----
+)EOF";
@@ -0,0 +1,51 @@
+// SpscQueue.h
+#ifndef SpscQueue_h
+#define SpscQueue_h
+
+#include <Arduino.h>
+#include <atomic>
+
+// Lock-free ring of N items from exactly one producer task to exactly one consumer task,
+// which may run on different cores.
+// The producer only writes head and the consumer only writes tail, each with a release
+// store after the item is copied, so neither side takes a lock or disables interrupts and
+// a task on the other core is never held up. Loads and stores only, the ESP32-C3 has no
+// atomic read-modify-write instructions. push() and pop() never block; the consumer waits
+// on a task notification from the producer, see the sketch.
+template <typename T, size_t N>
+class SpscQueue
+{
+public:
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue length must be a power of two");
+
+    // Producer only: copy item in, false if the queue is full
+    bool push(const T &item)
+    {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead - tail.load(std::memory_order_acquire) >= N)
+            return false;
+        items[currentHead & (N - 1)] = item;
+        head.store(currentHead + 1, std::memory_order_release); // Publishes the item to the consumer
+        return true;
+    }
+
+    // Consumer only: copy the oldest item out, false if the queue is empty
+    bool pop(T &item)
+    {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail == head.load(std::memory_order_acquire))
+            return false;
+        item = items[currentTail & (N - 1)];
+        tail.store(currentTail + 1, std::memory_order_release); // Hands the slot back to the producer
+        return true;
+    }
+
+    size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); } // Items waiting, a snapshot
+
+private:
+    T items[N];                  // Ring storage, slot i & (N - 1)
+    std::atomic<size_t> head{0}; // Items ever pushed, producer only
+    std::atomic<size_t> tail{0}; // Items ever popped, consumer only
+};
+
+#endif // SpscQueue_h
@@ -0,0 +1,213 @@
+// TelemetryBuffer.h
+#ifndef TelemetryBuffer_h
+#define TelemetryBuffer_h
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include "TelemetryRecord.h"
+
+// Store-and-forward ring of TelemetryRecord kept in a raw flash data partition.
+// Record n always lives in slot n % slotCount, so a boot scan recovers the ring from the
+// sequence numbers alone. Sectors are erased in order as the head enters them, which spreads
+// wear evenly over the whole ring; a full ring overwrites its oldest sector.
+// Delivery is persisted by clearing the pending bit of the newest delivered record, one
+// byte write per drained batch instead of a separate index that would wear one sector.
+class TelemetryBuffer
+{
+public:
+    static constexpr size_t SECTOR_SIZE = 4096;                           // Flash erase unit
+    static constexpr size_t RECORD_SIZE = sizeof(TelemetryRecord);        // Bytes per slot
+    static constexpr size_t SLOTS_PER_SECTOR = SECTOR_SIZE / RECORD_SIZE; // Records per sector
+    static constexpr uint8_t FLAG_PENDING = 0x80;                         // Cleared in flash once delivered
+    static constexpr uint32_t ERASED_SEQUENCE = 0xFFFFFFFF;               // Sequence read from erased flash
+
+    // Use the first `sectors` sectors of the data partition `label`, returns false if unusable
+    bool begin(const char *label, size_t sectors)
+    {
+        partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+        if (partition == nullptr)
+            return false;
+
+        size_t available = partition->size / SECTOR_SIZE;
+        sectorCount = sectors < available ? sectors : available;
+        if (sectorCount < 2) // One sector must stay readable while the next one is erased
+        {
+            partition = nullptr;
+            return false;
+        }
+        slotCount = sectorCount * SLOTS_PER_SECTOR;
+
+        recover(); // Rebuild head and tail from the records already in flash
+        return true;
+    }
+
+    // Append a record, the sequence number and CRC are filled in here
+    bool push(TelemetryRecord record)
+    {
+        if (partition == nullptr)
+            return false;
+
+        size_t slot = headSequence % slotCount;
+        if (slot % SLOTS_PER_SECTOR == 0) // Entering a sector, erase it before the first write
+        {
+            if (esp_partition_erase_range(partition, slot * RECORD_SIZE, SECTOR_SIZE) != ESP_OK)
+                return false;
+
+            // The erased sector held the oldest records of a full ring
+            uint32_t retained = slotCount - SLOTS_PER_SECTOR;
+            if (headSequence > retained && tailSequence < headSequence - retained)
+            {
+                droppedCount += headSequence - retained - tailSequence;
+                tailSequence = headSequence - retained;
+            }
+        }
+
+        record.sequence = headSequence;
+        record.flags |= FLAG_PENDING;
+        record.crc = checksum(record);
+        if (esp_partition_write(partition, slot * RECORD_SIZE, &record, RECORD_SIZE) != ESP_OK)
+            return false;
+
+        headSequence++;
+        return true;
+    }
+
+    // Copy up to maxRecords undelivered records with sequence >= from, returns the number copied
+    size_t read(uint32_t from, TelemetryRecord *records, size_t maxRecords) const
+    {
+        if (partition == nullptr)
+            return 0;
+
+        size_t count = 0;
+        for (uint32_t sequence = from < tailSequence ? tailSequence : from; sequence < headSequence && count < maxRecords; sequence++)
+        {
+            if (readSlot(sequence, records[count])) // Torn or overwritten slots are skipped
+                count++;
+        }
+        return count;
+    }
+
+    // Mark every record up to and including `sequence` as delivered
+    void release(uint32_t sequence)
+    {
+        if (partition == nullptr || sequence < tailSequence || sequence >= headSequence)
+            return;
+        tailSequence = sequence + 1;
+
+        // Persist the new tail on the newest readable record at or below `sequence`
+        TelemetryRecord record;
+        for (uint32_t i = 0; i < SLOTS_PER_SECTOR && i <= sequence; i++)
+        {
+            if (!readSlot(sequence - i, record))
+                continue;
+            uint8_t flags = record.flags & ~FLAG_PENDING; // Only clears bits, no erase needed
+            size_t offset = ((sequence - i) % slotCount) * RECORD_SIZE + offsetof(TelemetryRecord, flags);
+            esp_partition_write(partition, offset, &flags, sizeof(flags));
+            return;
+        }
+    }
+
+    bool isAvailable() const { return partition != nullptr; }        // True once begin() found the partition
+    bool isEmpty() const { return headSequence == tailSequence; }    // True if nothing waits for delivery
+    size_t size() const { return headSequence - tailSequence; }      // Undelivered records, including unreadable slots
+    size_t capacity() const { return slotCount - SLOTS_PER_SECTOR; } // Records always kept before the oldest are overwritten
+    uint32_t oldestSequence() const { return tailSequence; }         // First undelivered sequence
+    uint32_t newestSequence() const { return headSequence - 1; }     // Last sequence written
+    uint32_t droppedRecords() const { return droppedCount; }         // Records overwritten before delivery
+
+private:
+    const esp_partition_t *partition = nullptr; // Partition holding the ring
+    size_t sectorCount = 0;                     // Sectors used by the ring
+    size_t slotCount = 0;                       // Record slots in the ring
+    uint32_t headSequence = 0;                  // Sequence of the next record to write
+    uint32_t tailSequence = 0;                  // Sequence of the oldest undelivered record
+    uint32_t droppedCount = 0;                  // Records lost to overwrite since boot
+
+    // CRC-16/CCITT over the record with the pending bit set, so clearing it keeps the CRC valid
+    static uint16_t checksum(const TelemetryRecord &record)
+    {
+        TelemetryRecord copy = record;
+        copy.flags |= FLAG_PENDING;
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&copy);
+
+        uint16_t crc = 0xFFFF;
+        for (size_t i = 0; i < offsetof(TelemetryRecord, crc); i++)
+        {
+            crc ^= (uint16_t)bytes[i] << 8;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+        return crc;
+    }
+
+    // A slot is valid if its CRC matches and it holds the sequence that maps to it
+    bool isValid(const TelemetryRecord &record, size_t slot) const
+    {
+        return record.sequence != ERASED_SEQUENCE && record.sequence % slotCount == slot && record.crc == checksum(record);
+    }
+
+    bool readSlot(uint32_t sequence, TelemetryRecord &record) const
+    {
+        size_t slot = sequence % slotCount;
+        if (esp_partition_read(partition, slot * RECORD_SIZE, &record, RECORD_SIZE) != ESP_OK)
+            return false;
+        return record.sequence == sequence && isValid(record, slot);
+    }
+
+    bool isSlotErased(uint32_t sequence) const
+    {
+        uint32_t words[RECORD_SIZE / sizeof(uint32_t)];
+        if (esp_partition_read(partition, (sequence % slotCount) * RECORD_SIZE, words, sizeof(words)) != ESP_OK)
+            return false;
+        for (uint32_t word : words)
+        {
+            if (word != 0xFFFFFFFF)
+                return false;
+        }
+        return true;
+    }
+
+    // Scan every slot once, a 64 KB ring takes 256 reads of 256 bytes
+    void recover()
+    {
+        bool found = false;           // Any valid record seen
+        bool delivered = false;       // Any delivered record seen
+        uint32_t newest = 0;          // Highest valid sequence
+        uint32_t oldest = 0;          // Lowest valid sequence
+        uint32_t newestDelivered = 0; // Highest sequence with the pending bit cleared
+
+        TelemetryRecord chunk[16];
+        for (size_t first = 0; first < slotCount; first += 16)
+        {
+            if (esp_partition_read(partition, first * RECORD_SIZE, chunk, sizeof(chunk)) != ESP_OK)
+                continue;
+            for (size_t i = 0; i < 16; i++)
+            {
+                const TelemetryRecord &record = chunk[i];
+                if (!isValid(record, first + i))
+                    continue;
+                if (!found || record.sequence > newest)
+                    newest = record.sequence;
+                if (!found || record.sequence < oldest)
+                    oldest = record.sequence;
+                found = true;
+                if (!(record.flags & FLAG_PENDING) && (!delivered || record.sequence > newestDelivered))
+                {
+                    newestDelivered = record.sequence;
+                    delivered = true;
+                }
+            }
+        }
+
+        headSequence = found ? newest + 1 : 0;
+        tailSequence = found ? oldest : 0;
+        if (delivered && newestDelivered + 1 > tailSequence)
+            tailSequence = newestDelivered + 1;
+
+        // Skip slots left dirty by a write cut short, push() must only program erased flash
+        while (headSequence % SLOTS_PER_SECTOR != 0 && !isSlotErased(headSequence))
+            headSequence++;
+    }
+};
+
+#endif // TelemetryBuffer_h
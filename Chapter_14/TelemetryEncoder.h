@@ -0,0 +1,110 @@
+// TelemetryEncoder.h
+#ifndef TelemetryEncoder_h
+#define TelemetryEncoder_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "TelemetryRecord.h"
+
+// Fields sent once per message, date and time are left out when NULL (lean payload)
+struct TelemetryEnvelope
+{
+    const char *deviceModel; // Sensor model, such as "DHT11"
+    const char *deviceID;    // Device identifier
+    const char *date;        // Local date "mm-dd-yyyy" of the first reading, or NULL
+    const char *time;        // Local time "hh:mm:ss" of the first reading, or NULL
+    const char *timeZone;    // Time zone string, such as "-08:00"
+    const char *dst;         // DST status string
+};
+
+// Telemetry message of the AWS IoT rule, built from TelemetryRecords into a JsonDocument.
+// A single reading keeps the original flat document; a batch sends the envelope once and
+// one {timeStamp, status, data} entry per reading in "samples". encode() writes the
+// document as JSON or MessagePack straight into the caller buffer.
+// Kept apart from the sketch so the publish path can be benchmarked on the host.
+class TelemetryEncoder
+{
+public:
+    // statusNames holds one status string per SensorConditionStatus, the last one for out of range values
+    TelemetryEncoder(const char *const *statusNames, size_t statusCount) : statusNames(statusNames), statusCount(statusCount) {}
+
+    // Fill doc with count readings, false if its allocator ran out
+    bool build(JsonDocument &doc, const TelemetryRecord *records, size_t count, bool batched, const TelemetryEnvelope &envelope) const
+    {
+        if (!batched) // One reading per message, the original format
+        {
+            doc["timeStamp"] = records[0].timestamp;
+            doc["deviceModel"] = envelope.deviceModel;
+            doc["deviceID"] = envelope.deviceID;
+            doc["status"] = statusName(records[0].condition);
+            addEnvelopeTime(doc, envelope);
+            doc["timeZone"] = envelope.timeZone;
+            doc["DST"] = envelope.dst;
+            addSampleData(doc.createNestedObject("data"), records[0]); // Create a nested object for data
+        }
+        else // The envelope once, then every reading with its own time stamp and status
+        {
+            doc["deviceModel"] = envelope.deviceModel;
+            doc["deviceID"] = envelope.deviceID;
+            addEnvelopeTime(doc, envelope);
+            doc["timeZone"] = envelope.timeZone;
+            doc["DST"] = envelope.dst;
+            JsonArray samples = doc.createNestedArray("samples"); // Create a nested array for the readings
+            for (size_t i = 0; i < count; i++)
+            {
+                JsonObject sample = samples.createNestedObject();
+                sample["timeStamp"] = records[i].timestamp;
+                sample["status"] = statusName(records[i].condition);
+                addSampleData(sample.createNestedObject("data"), records[i]);
+            }
+        }
+        return !doc.overflowed();
+    }
+
+    // Encode doc into out, returns the length or 0 if it does not fit
+    static size_t encode(const JsonDocument &doc, bool msgpack, uint8_t *out, size_t size)
+    {
+        size_t length = msgpack ? serializeMsgPack(doc, out, size) : serializeJson(doc, (char *)out, size);
+        return length == 0 || length >= size - 1 ? 0 : length; // A full buffer means the payload was cut off
+    }
+
+    // Longest JSON message of count readings, for sizing the payload buffer; MessagePack is
+    // always shorter. Assumes status strings of up to 12 characters, such as "Sensor Error"
+    static constexpr size_t maxEncodedSize(size_t count, bool batched)
+    {
+        return (batched ? sizeof(MAX_ENVELOPE_JSON) - 1 + count * (sizeof(MAX_SAMPLE_JSON) - 1) : sizeof(MAX_SINGLE_JSON) - 1) + 2; // encode() treats a full buffer as cut off
+    }
+
+    // Status string of a SensorConditionStatus
+    const char *statusName(uint8_t condition) const { return statusNames[condition < statusCount ? condition : statusCount - 1]; }
+
+private:
+    // Worst cases of maxEncodedSize(): a 10 digit time stamp, numbers at the int16 limits printed
+    // with float noise, a 16 digit device ID and a 9 character time zone
+    static constexpr char MAX_SAMPLE_JSON[] = "{\"timeStamp\":4294967295,\"status\":\"Sensor Error\",\"data\":{\"temp_C\":-327.670013,\"temp_F\":-558,\"humidity\":-327.670013}},";
+    static constexpr char MAX_ENVELOPE_JSON[] = "{\"deviceModel\":\"DHT11\",\"deviceID\":\"0123456789ABCDEF\",\"date\":\"12-31-2026\",\"time\":\"23:59:59\",\"timeZone\":\"+14:00:00\",\"DST\":\"Yes\",\"samples\":[]}";
+    static constexpr char MAX_SINGLE_JSON[] = "{\"timeStamp\":4294967295,\"deviceModel\":\"DHT11\",\"deviceID\":\"0123456789ABCDEF\",\"status\":\"Sensor Error\",\"date\":\"12-31-2026\",\"time\":\"23:59:59\",\"timeZone\":\"+14:00:00\",\"DST\":\"Yes\",\"data\":{\"temp_C\":-327.670013,\"temp_F\":-558,\"humidity\":-327.670013}}";
+
+    const char *const *statusNames; // Status strings indexed by SensorConditionStatus
+    const size_t statusCount;       // Entries in statusNames
+
+    static void addEnvelopeTime(JsonDocument &doc, const TelemetryEnvelope &envelope)
+    {
+        if (envelope.date == NULL || envelope.time == NULL) // Lean payload, the receiver derives them from timeStamp
+            return;
+        doc["date"] = envelope.date;
+        doc["time"] = envelope.time;
+    }
+
+    // Add the measured values of a reading
+    static void addSampleData(JsonObject data, const TelemetryRecord &record)
+    {
+        float temperatureC = decodeTelemetryValue(record.temperatureC); // NAN for a sensor error
+        float temperatureF = temperatureC * 9.0 / 5.0 + 32.0;           // Derived from Celsius like DHT11Sensor does
+        data["temp_C"] = temperatureC;
+        data["temp_F"] = round(temperatureF);
+        data["humidity"] = decodeTelemetryValue(record.humidity);
+    }
+};
+
+#endif // TelemetryEncoder_h
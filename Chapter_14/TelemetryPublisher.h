@@ -0,0 +1,95 @@
+// TelemetryPublisher.h
+#ifndef TelemetryPublisher_h
+#define TelemetryPublisher_h
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include "TelemetryRecord.h"
+#include "TelemetryEncoder.h"
+#include "TimeService.h"
+
+// Publish path of the telemetry, from TelemetryRecords to one MQTT PUBLISH: formats the
+// date and time of the first reading, builds the document in the static arena, encodes it
+// into the static payload buffer and publishes it with QoS 0 or QoS 1 on the Session.
+// The sketch and bench/TelemetryBench.cpp both publish through it, so the benchmark times
+// the code that runs on the device. The time of the build and encode and of the PUBLISH
+// is kept for the caller metrics.
+template <typename Session, typename Arena>
+class TelemetryPublisher
+{
+public:
+    // Result of publish()
+    enum Status
+    {
+        Published,       // PUBLISH written, for QoS 1 confirmed later by takeConfirmed()
+        NotConnected,    // No MQTT session, nothing built
+        ArenaFull,       // The document did not fit the arena
+        PayloadTooLarge, // The encoded payload did not fit the payload buffer
+        PublishFailed    // The session did not write the PUBLISH
+    };
+
+    // Payload format, the TELEMETRY_* flags of the sketch
+    struct Format
+    {
+        bool batched; // Envelope plus "samples", rather than the single reading document
+        bool lean;    // Date and time left out of the envelope
+        bool msgpack; // MessagePack rather than JSON
+    };
+
+    TelemetryPublisher(const TelemetryEncoder &encoder, Arena &arena, uint8_t *payload, size_t payloadSize, TimeService &timeService, Session &session)
+        : encoder(encoder), arena(arena), payload(payload), payloadSize(payloadSize), timeService(timeService), session(session) {}
+
+    // Publish count readings as one message on topic; with confirmed, QoS 1 with the last
+    // sequence as the token. The date and time of envelope are filled in here unless lean
+    Status publish(const char *topic, const TelemetryRecord *records, size_t count, TelemetryEnvelope envelope, const Format &format, bool confirmed)
+    {
+        payloadLength = 0;
+        encodeUs = publishUs = 0;
+        if (!session.connected())
+            return NotConnected;
+
+        int64_t encodeStartUs = esp_timer_get_time();
+        if (!format.lean) // The date string is cached per day, stored by pointer in the document
+        {
+            envelope.date = timeService.date(records[0].timestamp);
+            timeService.formatTime(records[0].timestamp, formattedTime);
+            envelope.time = formattedTime;
+        }
+        arena.reset(); // The previous document is gone
+        {
+            JsonDocument doc(&arena);
+            if (!encoder.build(doc, records, count, format.batched, envelope))
+                return ArenaFull;
+            payloadLength = TelemetryEncoder::encode(doc, format.msgpack, payload, payloadSize);
+        }
+        encodeUs = esp_timer_get_time() - encodeStartUs;
+        if (payloadLength == 0)
+            return PayloadTooLarge;
+
+        int64_t publishStartUs = esp_timer_get_time();
+        bool published = confirmed ? session.publishConfirmed(topic, payload, payloadLength, records[count - 1].sequence) // Committed on its PUBACK
+                                   : session.publish(topic, payload, payloadLength);
+        publishUs = esp_timer_get_time() - publishStartUs;
+        return published ? Published : PublishFailed;
+    }
+
+    const uint8_t *lastPayload() const { return payload; }     // Encoded payload of the last publish()
+    size_t lastPayloadLength() const { return payloadLength; } // Its length, 0 if nothing was encoded
+    uint32_t lastEncodeUs() const { return encodeUs; }         // Build and encode time of the last payload
+    uint32_t lastPublishUs() const { return publishUs; }       // PUBLISH time of the last written payload
+
+private:
+    const TelemetryEncoder &encoder;                 // Document builder and encoder
+    Arena &arena;                                    // Static document memory
+    uint8_t *const payload;                          // Static payload buffer
+    const size_t payloadSize;                        // Bytes in payload
+    TimeService &timeService;                        // Cached date and time strings
+    Session &session;                                // MQTT session of the PUBLISH
+    char formattedTime[TimeService::TIME_SIZE] = {}; // "hh:mm:ss" of the envelope, referenced until the next publish()
+    size_t payloadLength = 0;                        // Bytes of the last payload
+    uint32_t encodeUs = 0;                           // Build and encode time of the last payload
+    uint32_t publishUs = 0;                          // PUBLISH time of the last written payload
+};
+
+#endif // TelemetryPublisher_h
@@ -0,0 +1,36 @@
+// TelemetryRecord.h
+#ifndef TelemetryRecord_h
+#define TelemetryRecord_h
+
+#include <Arduino.h>
+
+constexpr int16_t TELEMETRY_VALUE_INVALID = INT16_MIN; // Marks a value the sensor did not deliver
+constexpr uint8_t TELEMETRY_FLAG_UNSYNCED = 0x01;      // timestamp holds seconds since boot, the clock was not set yet
+constexpr uint8_t TELEMETRY_FLAG_FLUSH = 0x02;         // Publish the batch with this reading at once, such as a confirmed condition change
+
+// Compact fixed-size sensor reading, the unit stored in and drained from TelemetryBuffer
+struct TelemetryRecord
+{
+    uint32_t sequence;    // Record number, assigned by TelemetryBuffer::push()
+    uint32_t timestamp;   // Unix time of the reading
+    int16_t temperatureC; // Temperature in 0.01 °C
+    int16_t humidity;     // Relative humidity in 0.01 %
+    uint8_t condition;    // SensorConditionStatus of the reading
+    uint8_t flags;        // Record flags, the top bit is reserved for TelemetryBuffer
+    uint16_t crc;         // CRC-16 of the record, computed by TelemetryBuffer
+};
+static_assert(sizeof(TelemetryRecord) == 16, "TelemetryRecord must stay 16 bytes");
+
+// Convert a reading to the fixed-point representation, NAN becomes TELEMETRY_VALUE_INVALID
+inline int16_t encodeTelemetryValue(float value)
+{
+    return isnan(value) ? TELEMETRY_VALUE_INVALID : (int16_t)lroundf(value * 100.0f);
+}
+
+// Convert a fixed-point value back to a reading, TELEMETRY_VALUE_INVALID becomes NAN
+inline float decodeTelemetryValue(int16_t value)
+{
+    return value == TELEMETRY_VALUE_INVALID ? NAN : value / 100.0f;
+}
+
+#endif // TelemetryRecord_h
@@ -0,0 +1,79 @@
+// TimeService.h
+#ifndef TimeService_h
+#define TimeService_h
+
+#include <Arduino.h>
+#include <time.h>
+
+// Local date and time strings of Unix time stamps for the telemetry payload.
+// localtime_r() only runs when a time stamp leaves the cached local hour, the unit in
+// which DST changes happen. Within the hour, minutes and seconds come from integer math,
+// and the date string is only re-rendered when the day changes.
+class TimeService
+{
+public:
+    static constexpr size_t DATE_SIZE = 11; // "mm-dd-yyyy" and the terminator
+    static constexpr size_t TIME_SIZE = 9;  // "hh:mm:ss" and the terminator
+
+    // Local date of `unixTime`, the string stays valid until a time stamp of another day is formatted
+    const char *date(time_t unixTime)
+    {
+        update(unixTime);
+        return dateString;
+    }
+
+    // Write the local time of `unixTime` as "hh:mm:ss" into a TIME_SIZE buffer
+    void formatTime(time_t unixTime, char *buffer)
+    {
+        update(unixTime);
+        uint32_t secondsInHour = unixTime - hourStart;
+        writeTwoDigits(buffer, hour);
+        buffer[2] = ':';
+        writeTwoDigits(buffer + 3, secondsInHour / 60);
+        buffer[5] = ':';
+        writeTwoDigits(buffer + 6, secondsInHour % 60);
+        buffer[8] = '\0';
+    }
+
+private:
+    time_t hourStart = 0;       // Unix time the cached local hour starts at
+    bool hasHour = false;       // hourStart and hour are valid
+    uint8_t hour = 0;           // Local hour of hourStart
+    int yearDay = -1;           // tm_yday of dateString, -1 before the first render
+    int year = -1;              // tm_year of dateString
+    char dateString[DATE_SIZE]; // Cached "mm-dd-yyyy"
+
+    void update(time_t unixTime)
+    {
+        if (hasHour && unixTime >= hourStart && unixTime < hourStart + 3600)
+            return; // Same local hour, nothing to convert
+
+        struct tm timeinfo;
+        localtime_r(&unixTime, &timeinfo);
+        hourStart = unixTime - timeinfo.tm_min * 60 - timeinfo.tm_sec;
+        hour = timeinfo.tm_hour;
+        hasHour = true;
+
+        if (timeinfo.tm_yday == yearDay && timeinfo.tm_year == year)
+            return; // Same day, the date string is still right
+        yearDay = timeinfo.tm_yday;
+        year = timeinfo.tm_year;
+
+        int fullYear = timeinfo.tm_year + 1900;
+        writeTwoDigits(dateString, timeinfo.tm_mon + 1);
+        dateString[2] = '-';
+        writeTwoDigits(dateString + 3, timeinfo.tm_mday);
+        dateString[5] = '-';
+        writeTwoDigits(dateString + 6, fullYear / 100 % 100);
+        writeTwoDigits(dateString + 8, fullYear % 100);
+        dateString[10] = '\0';
+    }
+
+    static void writeTwoDigits(char *buffer, unsigned value)
+    {
+        buffer[0] = '0' + value / 10;
+        buffer[1] = '0' + value % 10;
+    }
+};
+
+#endif // TimeService_h
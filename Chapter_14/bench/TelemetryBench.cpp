@@ -0,0 +1,319 @@
+// TelemetryBench.cpp
+// Benchmark of the telemetry publish path of Chapter_14, from a sensor reading to the MQTT
+// bytes on the wire. The same source builds for the host (env:native, with the stand-ins
+// in bench/native) and for the board (env:bench), so both report the same numbers.
+// For every payload mode it times the document build and encode and the MQTT PUBLISH, and
+// counts payload bytes, wire bytes and heap allocations per publish. A loopback transport
+// answers CONNECT and QoS 1 PUBLISH like the broker, so the session runs unchanged.
+// Compare the output between releases to catch a regression before it ships.
+
+// **********************************
+// & Header List
+// **********************************
+#include <Arduino.h>               // Include the Arduino base library, or its host stand-in
+#include <esp_timer.h>             // Include the microsecond timer
+#include "../TelemetryRecord.h"    // Include the compact telemetry record
+#include "../TelemetryEncoder.h"   // Include the telemetry document builder and encoder
+#include "../ArenaAllocator.h"     // Include the static allocator for JSON documents
+#include "../TimeService.h"        // Include the cached date and time formatting
+#include "../MqttSession.h"        // Include the MQTT session with the QoS 1 in-flight window
+#include "../TelemetryPublisher.h" // Include the publish path of the sketch
+
+// **********************************
+// & Settings, overridden from platformio.ini build_flags
+// **********************************
+#ifndef BENCH_BATCH_SIZE
+#define BENCH_BATCH_SIZE 10 // Readings per batched message, as TELEMETRY_BATCH_SIZE
+#endif
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 100 // Messages published per mode
+#endif
+
+#ifdef ARDUINO
+#define BENCH_PRINTF(...) Serial.printf(__VA_ARGS__)
+#else
+#define BENCH_PRINTF(...) printf(__VA_ARGS__)
+#endif
+
+// * Payload modes, the compile-time TELEMETRY_* flags of the sketch chosen at run time
+struct BenchMode
+{
+    const char *name; // Printed mode name
+    size_t batchSize; // Readings per message, 1 is the original single reading format
+    bool isLean;      // Date and time left out, as TELEMETRY_LEAN_PAYLOAD
+    bool isMsgPack;   // MessagePack rather than JSON, as TELEMETRY_ENCODING_MSGPACK
+};
+constexpr BenchMode BENCH_MODES[] = {
+    {"json", 1, false, false},
+    {"json-batch", BENCH_BATCH_SIZE, false, false},
+    {"json-batch-lean", BENCH_BATCH_SIZE, true, false},
+    {"msgpack", 1, false, true},
+    {"msgpack-batch", BENCH_BATCH_SIZE, false, true},
+    {"msgpack-batch-lean", BENCH_BATCH_SIZE, true, true},
+};
+
+// * Payload memory, sized like the sketch for the largest batch
+constexpr const char *CONDITION_STRINGS[] = {"Normal", "Below Normal", "Above Normal", "Sensor Error"}; // Indexed by SensorConditionStatus
+constexpr size_t CONDITION_COUNT = sizeof(CONDITION_STRINGS) / sizeof(CONDITION_STRINGS[0]); // Entries in CONDITION_STRINGS
+constexpr size_t MQTT_PAYLOAD_SIZE = 256 + BENCH_BATCH_SIZE * 120;                           // JSON bytes for a full batch, up to 116 per sample
+static_assert(MQTT_PAYLOAD_SIZE >= TelemetryEncoder::maxEncodedSize(BENCH_BATCH_SIZE, BENCH_BATCH_SIZE > 1), "A full batch of Sensor Error samples must fit the payload buffer");
+constexpr size_t JSON_ARENA_SIZE = 1536 + BENCH_BATCH_SIZE * 256;                            // Document memory for a full batch
+const char *BENCH_TOPIC = "bench-device/pub";                                                // Topic of the loopback PUBLISHes
+
+// * Simulated DHT11, a slow daily swing plus noise across the normal limits
+constexpr float TEMP_MIN = 10.0, TEMP_MAX = 25.0; // Normal temperature range, as in the sketch
+constexpr float HUM_MIN = 10.0, HUM_MAX = 80.0;   // Normal humidity range, as in the sketch
+constexpr uint32_t SENSOR_ERROR_EVERY = 25;       // One failed read in this many
+constexpr uint32_t SAMPLE_PERIOD_S = 3;           // Seconds between readings
+constexpr uint32_t START_TIME = 1700000000;       // Unix time of the first reading
+
+// **********************************
+// & Loopback broker
+// **********************************
+// Transport of the MQTT session that keeps nothing: it counts the bytes written and queues
+// the CONNACK and PUBACK a broker would send back
+class BenchTransport
+{
+public:
+    bool connected() { return true; }
+    void stop() {}
+
+    size_t write(const uint8_t *data, size_t size)
+    {
+        tls_segment_t segment = {data, size};
+        return writev(&segment, 1);
+    }
+
+    size_t writev(const tls_segment_t *segments, size_t count)
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < count; i++)
+            total += segments[i].size;
+        bytesWritten += total;
+        if (count > 0)
+            answer(segments[0].data, segments[0].size); // The first segment holds the packet header
+        return total;
+    }
+
+    int read(uint8_t *buffer, size_t size)
+    {
+        if (replyLength == 0)
+            return -1; // Nothing received, like WiFiClientSecure::read()
+        size_t length = replyLength < size ? replyLength : size;
+        memcpy(buffer, reply, length);
+        memmove(reply, reply + length, replyLength - length);
+        replyLength -= length;
+        return length;
+    }
+
+    uint64_t bytesWritten = 0; // Bytes the session has written
+
+private:
+    uint8_t reply[16];      // Packets waiting to be read by the session
+    size_t replyLength = 0; // Bytes in reply
+
+    void queue(uint8_t type, uint8_t high, uint8_t low)
+    {
+        if (replyLength + 4 > sizeof(reply))
+            return;
+        uint8_t packet[] = {type, 0x02, high, low};
+        memcpy(reply + replyLength, packet, sizeof(packet));
+        replyLength += sizeof(packet);
+    }
+
+    void answer(const uint8_t *packet, size_t size)
+    {
+        if (size == 0)
+            return;
+        if ((packet[0] & 0xF0) == 0x10) // CONNECT, accept it
+        {
+            queue(0x20, 0x00, 0x00);
+            return;
+        }
+        if (packet[0] != 0x32) // Only a QoS 1 PUBLISH is acknowledged
+            return;
+        size_t offset = 1;
+        while (offset < size && (packet[offset] & 0x80)) // Remaining length
+            offset++;
+        offset++;
+        if (offset + 2 > size)
+            return;
+        size_t packetIdOffset = offset + 2 + ((packet[offset] << 8) | packet[offset + 1]); // Behind the topic
+        if (packetIdOffset + 2 <= size)
+            queue(0x40, packet[packetIdOffset], packet[packetIdOffset + 1]); // PUBACK
+    }
+};
+
+// **********************************
+// & Allocation counter
+// **********************************
+// malloc() and friends are wrapped at link time with -Wl,--wrap, so every heap allocation of
+// the image is counted, ArduinoJson and the C++ runtime included
+volatile uint32_t allocationCount = 0; // Heap allocations since boot
+
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t count, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+
+    void *__wrap_malloc(size_t size)
+    {
+        allocationCount++;
+        return __real_malloc(size);
+    }
+
+    void *__wrap_calloc(size_t count, size_t size)
+    {
+        allocationCount++;
+        return __real_calloc(count, size);
+    }
+
+    void *__wrap_realloc(void *ptr, size_t size)
+    {
+        allocationCount++;
+        return __real_realloc(ptr, size);
+    }
+}
+
+// The host C++ runtime is a shared library, route new through the wrapped malloc()
+void *operator new(size_t size) { return malloc(size); }
+void *operator new[](size_t size) { return malloc(size); }
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+
+// **********************************
+// & Global Variables
+// **********************************
+typedef TelemetryPublisher<MqttSession<4, BenchTransport>, ArenaAllocator<JSON_ARENA_SIZE>> BenchPublisher;
+TelemetryEncoder telemetryEncoder(CONDITION_STRINGS, CONDITION_COUNT); // Same builder as the sketch
+ArenaAllocator<JSON_ARENA_SIZE> jsonArena;                             // Static document memory, reset by every publish
+uint8_t mqttPayloadBuffer[MQTT_PAYLOAD_SIZE];                          // Encoded payload, reused by every publish
+TimeService timeService;                                               // Cached local date and time strings of the payload
+BenchTransport transport;                                              // Loopback broker
+MqttSession<4, BenchTransport> mqttClient(transport);                  // MQTT session of the sketch on the loopback
+BenchPublisher telemetryPublisher(telemetryEncoder, jsonArena, mqttPayloadBuffer, sizeof(mqttPayloadBuffer), timeService, mqttClient); // Publish path of the sketch
+TelemetryRecord batch[BENCH_BATCH_SIZE];                               // Readings of the next message
+uint32_t sampleNumber = 0;                                             // Readings taken since the start
+
+// **********************************
+// & Function Declarations
+// **********************************
+TelemetryRecord readSimulatedSensor(); // Function to take one simulated DHT11 reading
+void runMode(const BenchMode &mode);   // Function to benchmark one payload mode
+void runBenchmark();                   // Function to benchmark every payload mode
+
+// **********************************
+// & Functions  Definition
+// **********************************
+TelemetryRecord readSimulatedSensor() // Function to take one simulated DHT11 reading
+{
+    TelemetryRecord record = {};
+    uint32_t n = sampleNumber++;
+    record.sequence = n;
+    record.timestamp = START_TIME + n * SAMPLE_PERIOD_S;
+    if (n % SENSOR_ERROR_EVERY == SENSOR_ERROR_EVERY - 1) // A failed read, as checkSensorReadings() records it
+    {
+        record.temperatureC = encodeTelemetryValue(NAN);
+        record.humidity = encodeTelemetryValue(NAN);
+        record.condition = 3; // SensorError
+        return record;
+    }
+
+    float phase = n * 0.05f;
+    float temperatureC = 20.0f + 12.0f * sinf(phase) + (n % 7) * 0.1f;
+    float humidity = 50.0f + 35.0f * cosf(phase) + (n % 5) * 0.2f;
+    record.temperatureC = encodeTelemetryValue(temperatureC);
+    record.humidity = encodeTelemetryValue(humidity);
+    if (temperatureC >= TEMP_MIN && temperatureC <= TEMP_MAX && humidity >= HUM_MIN && humidity <= HUM_MAX)
+        record.condition = 0; // Normal
+    else if (temperatureC < TEMP_MIN || humidity < HUM_MIN)
+        record.condition = 1; // BelowNormal
+    else
+        record.condition = 2; // AboveNormal
+    return record;
+}
+
+void runMode(const BenchMode &mode) // Function to benchmark one payload mode
+{
+    uint64_t encodeTotalUs = 0, publishTotalUs = 0, payloadTotal = 0;
+    uint32_t encodeMaxUs = 0, allocations = 0, failures = 0;
+    uint64_t wireStart = transport.bytesWritten;
+
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        for (size_t k = 0; k < mode.batchSize; k++)
+            batch[k] = readSimulatedSensor();
+
+        // The publish path of mqttPublishMessage(), timed in the same two parts as the sketch metrics
+        uint32_t allocationsBefore = allocationCount;
+        TelemetryEnvelope envelope = {"DHT11", "bench-device", NULL, NULL, "-08:00", "DST"};
+        BenchPublisher::Format format = {mode.batchSize > 1, mode.isLean, mode.isMsgPack};
+        bool published = telemetryPublisher.publish(BENCH_TOPIC, batch, mode.batchSize, envelope, format, true) == BenchPublisher::Published;
+        uint32_t encodeUs = telemetryPublisher.lastEncodeUs();
+        size_t payloadLength = telemetryPublisher.lastPayloadLength();
+
+        int64_t pubackStartUs = esp_timer_get_time();
+        mqttClient.loop(); // Read the PUBACK
+        uint32_t token;
+        while (mqttClient.takeConfirmed(token))
+            ;
+        publishTotalUs += telemetryPublisher.lastPublishUs() + (esp_timer_get_time() - pubackStartUs); // The PUBLISH and its PUBACK
+        allocations += allocationCount - allocationsBefore;
+
+        if (!published)
+            failures++;
+        encodeTotalUs += encodeUs;
+        if (encodeUs > encodeMaxUs)
+            encodeMaxUs = encodeUs;
+        payloadTotal += payloadLength;
+    }
+
+    uint32_t samples = BENCH_ITERATIONS * mode.batchSize;
+    uint64_t wireBytes = transport.bytesWritten - wireStart;
+    BENCH_PRINTF("%-19s %7u %9.1f %9u %10.1f %9.1f %9.1f %9.1f %8.2f %5u\n", mode.name, (unsigned)mode.batchSize,
+                 (double)encodeTotalUs / BENCH_ITERATIONS, (unsigned)encodeMaxUs, (double)publishTotalUs / BENCH_ITERATIONS,
+                 (double)payloadTotal / BENCH_ITERATIONS, (double)payloadTotal / samples, (double)wireBytes / samples,
+                 (double)allocations / BENCH_ITERATIONS, (unsigned)failures);
+}
+
+void runBenchmark() // Function to benchmark every payload mode
+{
+#ifdef ARDUINO
+    BENCH_PRINTF("Telemetry benchmark on %s at %u MHz, %u messages per mode\n", ESP.getChipModel(), (unsigned)ESP.getCpuFreqMHz(), (unsigned)BENCH_ITERATIONS);
+#else
+    BENCH_PRINTF("Telemetry benchmark on the host, %u messages per mode\n", (unsigned)BENCH_ITERATIONS);
+#endif
+    if (!mqttClient.connect("bench-device", 60))
+    {
+        BENCH_PRINTF("Loopback CONNECT failed, state %d\n", mqttClient.state());
+        return;
+    }
+    BENCH_PRINTF("%-19s %7s %9s %9s %10s %9s %9s %9s %8s %5s\n", "mode", "samples", "encode_us", "max_us", "publish_us",
+                 "payload_B", "B/sample", "wire_B/s", "allocs", "fails");
+    for (const BenchMode &mode : BENCH_MODES)
+        runMode(mode);
+    BENCH_PRINTF("JSON arena peak: %u of %u bytes\n", (unsigned)jsonArena.peakUsage(), (unsigned)jsonArena.capacity());
+}
+
+#ifdef ARDUINO
+void setup()
+{
+    Serial.begin(115200);
+    delay(2000); // Time to open the monitor
+    runBenchmark();
+}
+
+void loop()
+{
+    delay(1000);
+}
+#else
+int main()
+{
+    runBenchmark();
+    return 0;
+}
+#endif
@@ -0,0 +1,31 @@
+// Arduino.h
+#ifndef Arduino_h
+#define Arduino_h
+
+// Host stand-in for the Arduino core, only what the benchmarked headers use
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// Microseconds of the monotonic clock, like the ESP32 timer counts from boot
+inline uint64_t hostMicros()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+inline unsigned long millis() { return (unsigned long)(hostMicros() / 1000); }
+inline unsigned long micros() { return (unsigned long)hostMicros(); }
+
+inline void delay(unsigned long ms)
+{
+    timespec wait = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000};
+    nanosleep(&wait, NULL);
+}
+
+#endif // Arduino_h
@@ -0,0 +1,14 @@
+// WiFiClientSecure.h
+#ifndef WiFiClientSecure_h
+#define WiFiClientSecure_h
+
+// Host stand-in for the Chapter_06 WiFiClientSecure, MqttSession only needs the writev() segment type
+#include <Arduino.h>
+
+typedef struct
+{
+    const uint8_t *data; // Segment bytes
+    size_t size;         // Segment length
+} tls_segment_t;
+
+#endif // WiFiClientSecure_h
@@ -0,0 +1,10 @@
+// esp_timer.h
+#ifndef esp_timer_h
+#define esp_timer_h
+
+// Host stand-in for the ESP-IDF high resolution timer
+#include <Arduino.h>
+
+inline int64_t esp_timer_get_time() { return (int64_t)hostMicros(); }
+
+#endif // esp_timer_h
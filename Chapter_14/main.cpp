@@ -11,6 +11,8 @@
 // * Requirement Summary:
 // - Periodically read from DHT11 sensor connected to IO2.
 // - Indicate conditions via LEDs and Piezo Buzzer connected to IO11, IO12, and IO13.
+// - Run sampling, networking and indications in separate FreeRTOS tasks linked by queues.
+// - Optionally duty-cycle with deep sleep between samples for battery deployments (DUTY_CYCLE_MODE).
 // * Hardware Connection:
 // - DHT11 data pin -> IO2
 // - Piezo Buzzer -> IO11
@@ -22,13 +24,43 @@
 // - indicateConditionBelowRange()
 // - indicateConditionAboveRange()
 // - indicateSensorError()
-// - blinkLEDs()
-// - updateStatusLEDs()
 // - connectToWiFi()
 // - pingHost()
 // - syncNTP()
 // - connectAWS()
+// - serviceAWSConnection()
+// - makeTelemetryRecord()
+// - queueTelemetryRecord()
+// - serviceTelemetryBatch()
+// - flushTelemetryBatch()
+// - drainTelemetryBuffer()
+// - conditionToString()
 // - mqttPublishMessage()
+// - reportHeapUsage()
+// - publishMetrics()
+// - postIndicatorEvent()
+// - indicateCondition()
+// - sensorTask()
+// - networkTask()
+// - takeQueuedReadings()
+// - rebootAfterFlush()
+// - indicatorTask()
+// - applyIndicatorEvent()
+// - runDutyCycle()
+// - connectForDutyCycle()
+// - configureWiFiAddress()
+// - onTimeSync()
+// - isClockSet()
+// - serviceStartup()
+// - pingTask()
+// - startTask()
+// - onMqttMessage()
+// - serviceOta()
+// - publishJobStatus()
+// - edgeCondition()
+// - postEdgeSummary()
+// - publishEdgeSummary()
+// - appendWindowStats()
 // * Security Considerations:
 // - Ensure stable power supply to prevent erroneous readings.
 // - Avoid exposing the sensor to extreme conditions beyond its operating range.
@@ -38,28 +70,132 @@
 // **********************************
 // * Libraries Import
 // **********************************
-#include <Arduino.h>           // Include the Arduino base library
-#include "DHT.h"               // Include the library for the DHT sensor
-#include <WiFi.h>              // Include the WiFi library
-#include <ESP32Ping.h>         // Include the Ping library
-#include <WiFiClientSecure.h>  // Include the WiFiClientSecure library
-#include <time.h>              // Include the time library
-#include <ArduinoJson.h>       // Include the ArduinoJson library
-#include "SecureCredentials.h" // Include the secrets file
-#include <Update.h>            // Include the Update library
-#include <PubSubClient.h>      // Include the PubSubClient library
-#include "HardwareInfo.h"      // Include the HardwareInfo class
+#include <Arduino.h>            // Include the Arduino base library
+#include "DHT11Sensor.h"        // Include the DHT11 driver
+#include <WiFi.h>               // Include the WiFi library
+#include <ESP32Ping.h>          // Include the Ping library
+#include <WiFiClientSecure.h>   // Include the WiFiClientSecure library (Chapter_06 version with connectAsync())
+#include <time.h>               // Include the time library
+#include <ArduinoJson.h>        // Include the ArduinoJson library
+#include "SecureCredentials.h"  // Include the secrets file
+#include <Update.h>             // Include the Update library
+#include "MqttSession.h"        // Include the MQTT session with the QoS 1 in-flight window
+#include "HardwareInfo.h"       // Include the HardwareInfo class
+#include "WiFiCache.h"          // Include the cached Wi-Fi association for fast reconnects
+#include "IndicatorEngine.h"    // Include the timer driven LED and buzzer patterns
+#include "TelemetryBuffer.h"    // Include the flash ring buffer for offline telemetry
+#include "ArenaAllocator.h"     // Include the static allocator for JSON documents
+#include "TelemetryEncoder.h"   // Include the telemetry document builder and encoder
+#include "TimeService.h"        // Include the cached date and time formatting
+#include "TelemetryPublisher.h" // Include the telemetry publish path shared with the benchmark
+#include "SamplingEngine.h"     // Include the adaptive sampling and report-by-exception engine
+#include "EdgeAggregator.h"     // Include the debounced conditions and window statistics
+#include "SpscQueue.h"          // Include the lock-free queue between the sensor and network tasks
+#include "Metrics.h"            // Include the hot-path latency histograms and counters
+#include "Log.h"                // Include the leveled, non-blocking logging
+#include "OtaUpdater.h"         // Include the signed, resumable firmware update from AWS IoT jobs
+#include <mbedtls/base64.h>     // Include base64 decoding for the job signature
+#include <esp_sleep.h>          // Include the deep sleep API
+#include <esp_sntp.h>           // Include the SNTP API for the time sync callback
 
 // **********************************
 // * Constants Declaration
 // **********************************
 
+// * Telemetry batching, overridden from platformio.ini build_flags
+#ifndef TELEMETRY_BATCH_SIZE
+#define TELEMETRY_BATCH_SIZE 1 // Readings per MQTT message, 1 keeps the one-document-per-reading format
+#endif
+#ifndef TELEMETRY_BATCH_INTERVAL_MS
+#define TELEMETRY_BATCH_INTERVAL_MS 30000 // Longest time a reading waits for its batch to fill
+#endif
+
+// * Telemetry payload encoding, overridden from platformio.ini build_flags
+#define TELEMETRY_ENCODING_JSON 0    // Text JSON, required by the AWS IoT rule and IoT Analytics pipeline
+#define TELEMETRY_ENCODING_MSGPACK 1 // MessagePack, same document with binary numbers and no quoting
+#ifndef TELEMETRY_ENCODING
+#define TELEMETRY_ENCODING TELEMETRY_ENCODING_JSON
+#endif
+#ifndef TELEMETRY_LEAN_PAYLOAD
+#define TELEMETRY_LEAN_PAYLOAD 0 // 1 drops the date and time strings, consumers derive them from timeStamp and timeZone
+#endif
+
+// * Duty-cycled deep sleep mode, overridden from platformio.ini build_flags
+#ifndef DUTY_CYCLE_MODE
+#define DUTY_CYCLE_MODE 0 // 1 samples once per wake-up and deep sleeps in between
+#endif
+#ifndef DUTY_CYCLE_INTERVAL_MS
+#define DUTY_CYCLE_INTERVAL_MS 60000 // Wake-up period in duty-cycled mode
+#endif
+
+// * Adaptive sampling, overridden from platformio.ini build_flags
+#ifndef SAMPLING_ADAPTIVE
+#define SAMPLING_ADAPTIVE 0 // 1 samples faster near the thresholds and only publishes changes and a heartbeat
+#endif
+
+// * Edge aggregation, overridden from platformio.ini build_flags
+#ifndef EDGE_AGGREGATION
+#define EDGE_AGGREGATION 0 // 1 reports debounced conditions, publishes their changes at once and adds window summaries
+#endif
+
+// * Task placement, overridden from platformio.ini build_flags
+#ifndef TASK_CORE_PINNING
+#define TASK_CORE_PINNING 0 // 1 pins networking to the protocol core and sensing to the app core of a dual-core chip
+#endif
+
+// * Wi-Fi address settings, set WIFI_STATIC_IP, WIFI_STATIC_GATEWAY, WIFI_STATIC_SUBNET and WIFI_STATIC_DNS in build_flags to skip DHCP
+#ifndef WIFI_REUSE_LEASE
+#define WIFI_REUSE_LEASE 0 // 1 reuses the cached DHCP lease as a static address, only where the router reserves it
+#endif
+#ifdef WIFI_STATIC_IP
+constexpr bool WIFI_USE_CACHED_LEASE = false; // The static address wins over the cached lease
+#else
+constexpr bool WIFI_USE_CACHED_LEASE = WIFI_REUSE_LEASE;
+#endif
+
+// * Startup diagnostics, overridden from platformio.ini build_flags
+#ifndef PING_ON_STARTUP
+#define PING_ON_STARTUP 1 // 1 pings PING_HOST once Wi-Fi is up, in its own task so nothing waits on it
+#endif
+
+// * TLS credential settings, overridden from platformio.ini build_flags
+#ifndef AWS_CREDENTIALS_DER
+#define AWS_CREDENTIALS_DER 0 // 1 uses the DER arrays of SecureCredentials.h, parsed in place instead of decoding the PEM strings
+#endif
+#ifndef AWS_USE_CA_BUNDLE
+#define AWS_USE_CA_BUNDLE 0 // 1 verifies AWS IoT with the embedded Amazon-only certificate bundle instead of one parsed root CA
+#endif
+#ifndef TLS_MAX_FRAGMENT_LENGTH
+#define TLS_MAX_FRAGMENT_LENGTH 0 // 512, 1024, 2048 or 4096 asks the broker for smaller TLS records, 0 keeps 16 KB
+#endif
+#if AWS_USE_CA_BUNDLE
+// certs/x509_crt_bundle holds only Amazon Root CA 1 and 3 and Starfield Services Root G2, the roots
+// of AWS IoT and S3, and is embedded by board_build.embed_files. Rebuild it with gen_crt_bundle.py
+// of ESP-IDF: python gen_crt_bundle.py -i AmazonRootCA1.pem -i AmazonRootCA3.pem -i SFSRootCAG2.pem
+extern const uint8_t AWS_CA_BUNDLE_START[] asm("_binary_certs_x509_crt_bundle_start");
+extern const uint8_t AWS_CA_BUNDLE_END[] asm("_binary_certs_x509_crt_bundle_end");
+#endif
+
+// * MQTT delivery, overridden from platformio.ini build_flags
+#ifndef MQTT_QOS
+#define MQTT_QOS 0 // 1 sends every batch through the flash ring with QoS 1 and commits it on its PUBACK
+#endif
+
+// * Firmware updates, overridden from platformio.ini build_flags
+#ifndef OTA_ENABLED
+#define OTA_ENABLED 0 // 1 takes signed, optionally delta, firmware images from AWS IoT jobs, see OtaUpdater.h
+#endif
+
+// * Runtime metrics, overridden from platformio.ini build_flags
+#ifndef METRICS_INTERVAL_MS
+#define METRICS_INTERVAL_MS 0 // Interval between metrics messages on <deviceID>/metrics, 0 never publishes them
+#endif
+
 // * ESP32 Reboot Delay
 constexpr int ESP32_REBOOT_DELAY_MS = 5000; // Delay before rebooting the ESP32
 
 // * DHT11 Sensor Pins and Settings
-constexpr int DHT_PIN = 2;      // Pin connected to the DHT11 data pin
-constexpr int DHT_TYPE = DHT11; // Specify DHT11 type
+constexpr int DHT_PIN = 2; // Pin connected to the DHT11 data pin
 
 // * Data RGB LED Pins
 constexpr int DATA_LED_ABOVE_RED = 8;    // Pin for the red component of RGB LED
@@ -92,10 +228,18 @@ constexpr float HUM_MAX = 80.0;  // Maximum normal humidity
 
 // * DHT11 reading interval
 constexpr unsigned long SENSOR_READ_INTERVAL = 3000; // Interval between sensor readings
-unsigned long lastCheckTime = 0;                     // Last sensor check time
 constexpr int MAX_SENSOR_ERROR_RETRIES = 3;          // Maximum number of sensor error retries
 int sensorErrorCount = 0;                            // Counter for sensor error retries
 
+// * Adaptive sampling settings, with SAMPLING_ADAPTIVE=0 every reading is published every SENSOR_READ_INTERVAL
+constexpr unsigned long SENSOR_FAST_READ_INTERVAL = 1000;  // Interval near a threshold or during a transition
+constexpr unsigned long SENSOR_HEARTBEAT_INTERVAL = 60000; // Longest time between two published readings
+constexpr SamplingChannelConfig DHT_SAMPLING_CHANNELS[] = {
+    {0.5, 0.2, TEMP_MIN, TEMP_MAX, 1.0}, // Temperature: 0.5 °C deadband, fast within 1 °C of a threshold or above 0.2 °C/s
+    {2.0, 1.0, HUM_MIN, HUM_MAX, 3.0},   // Humidity: 2 % deadband, fast within 3 % of a threshold or above 1 %/s
+};
+SamplingEngine<2> dhtSampling(DHT_SAMPLING_CHANNELS, {SENSOR_READ_INTERVAL, SENSOR_FAST_READ_INTERVAL, SENSOR_HEARTBEAT_INTERVAL}); // Owned by the sensor task
+
 // * Data ranges for condition status
 enum SensorConditionStatus
 {
@@ -106,48 +250,279 @@ enum SensorConditionStatus
 };
 SensorConditionStatus currentCondition = SensorError; // Default to Error until the first successful reading
 
-// * Blinking control variables
-bool isBlinkingEnabled = false;                  // Flag for LED blinking state
-unsigned long lastBlinkTime = 0;                 // Last time the LED blinked
-constexpr long DATA_LED_BLINK_INTERVAL_MS = 100; // Interval between blinks
-int blinkingLED = -1;                            // Assuming -1 as an invalid value indicating no LED is set for blinking.
+// * Edge aggregation settings, with EDGE_AGGREGATION=1 the status of a reading only changes once confirmed
+constexpr EdgeChannelConfig DHT_EDGE_CHANNELS[] = {
+    {TEMP_MIN, TEMP_MAX, 0.5}, // Temperature: back inside the range by 0.5 °C before it is normal again
+    {HUM_MIN, HUM_MAX, 2.0},   // Humidity: back inside the range by 2 % before it is normal again
+};
+constexpr float EDGE_EMA_ALPHA = 0.2;                                                     // Weight of a new sample in the EMA, about the last 5 samples
+constexpr uint8_t EDGE_DEBOUNCE_SAMPLES = 2;                                              // Samples in a row that confirm a condition change
+constexpr unsigned long EDGE_SUMMARY_INTERVAL_MS = 300000;                                // Window of one summary message on <deviceID>/summary
+static_assert(EDGE_DEBOUNCE_SAMPLES < MAX_SENSOR_ERROR_RETRIES, "A failing sensor must be confirmed, and so flushed, before the reboot");
+EdgeAggregator<2> dhtAggregator(DHT_EDGE_CHANNELS, EDGE_EMA_ALPHA, EDGE_DEBOUNCE_SAMPLES); // Owned by the sensor task
+
+// Statistics of one summary window, from the sensor task to the network task
+struct EdgeSummary
+{
+    uint32_t timestamp;          // Unix time at the end of the window, 0 before the time sync
+    uint32_t windowS;            // Window length in seconds
+    uint32_t faults;             // Failed reads in the window
+    uint32_t changes;            // Confirmed condition changes since boot
+    uint8_t condition;           // Confirmed SensorConditionStatus
+    EdgeWindowStats quantity[2]; // Temperature and humidity
+};
+SpscQueue<EdgeSummary, 2> summaryQueue; // Window summaries, published by the network task
+
+// * Indicator events, sent from the sensor task to the indicator task
+enum IndicatorEvent
+{
+    IndicateNormal,
+    IndicateBelowRange,
+    IndicateAboveRange,
+    IndicateSensorError,
+};
+
+// * Indicator patterns, played by an esp_timer so they keep time while a task blocks
+constexpr uint16_t DATA_LED_BLINK_INTERVAL_MS = 100; // Interval between blinks
+constexpr uint8_t INDICATOR_RED = 1 << 0;            // Bit of the red data LED
+constexpr uint8_t INDICATOR_GREEN = 1 << 1;          // Bit of the green data LED
+constexpr uint8_t INDICATOR_BLUE = 1 << 2;           // Bit of the blue data LED
+constexpr uint8_t INDICATOR_SENSOR_ERROR = 1 << 3;   // Bit of LED D5
+constexpr uint8_t INDICATOR_BUZZER = 1 << 4;         // Bit of the Piezo Buzzer
+constexpr IndicatorOutput INDICATOR_OUTPUTS[] = {
+    {DATA_LED_ABOVE_RED, -1, HIGH},
+    {DATA_LED_NORMAL_GREEN, -1, HIGH},
+    {DATA_LED_BELOW_BLUE, -1, HIGH},
+    {SYS_LED_D5, SYS_LED_D5_CHANNEL, SYS_LED_ON},
+    {BUZZER_PIN, BUZZER_CHANNEL, BUZZER_VOLUME_HALF},
+};
+constexpr IndicatorPattern NORMAL_PATTERN = {1, {{INDICATOR_GREEN, 0}}};                                   // Green LED on
+constexpr IndicatorPattern SENSOR_ERROR_PATTERN = {1, {{INDICATOR_SENSOR_ERROR | INDICATOR_BUZZER, 0}}}; // LED D5 and buzzer on
+constexpr IndicatorPattern BELOW_RANGE_PATTERN = {2, {
+    {INDICATOR_BLUE | INDICATOR_BUZZER, DATA_LED_BLINK_INTERVAL_MS}, // Blue LED and buzzer on
+    {0, DATA_LED_BLINK_INTERVAL_MS},                                 // Everything off
+}};
+constexpr IndicatorPattern ABOVE_RANGE_PATTERN = {2, {
+    {INDICATOR_RED | INDICATOR_BUZZER, DATA_LED_BLINK_INTERVAL_MS}, // Red LED and buzzer on
+    {0, DATA_LED_BLINK_INTERVAL_MS},                                // Everything off
+}};
+IndicatorOutputs<5> indicatorOutputs(INDICATOR_OUTPUTS);                 // Data LEDs, LED D5 and buzzer
+IndicatorEngine<IndicatorOutputs<5>> indicatorEngine(indicatorOutputs); // Player of the patterns
 
 // * WiFi, Ping and NTP Sync settings
 const char *ssid = WIFI_SSID;                               // WiFi SSID
 const char *password = WIFI_PASSWORD;                       // WiFi password
 const char *host = PING_HOST;                               // Host to ping
 constexpr int MAX_WIFI_CONNECT_ATTEMPTS = 3;                // Maximum number of WiFi connection attempts
-constexpr unsigned long WIFI_CONNECT_RETRY_DELAY_MS = 5000; // Delay between WiFi connection attempts
+constexpr unsigned long WIFI_CONNECT_RETRY_DELAY_MS = 5000; // Longest wait for each WiFi connection attempt
+constexpr unsigned long WIFI_FAST_CONNECT_TIMEOUT_MS = 1500; // Longest wait for the directed association to the cached access point
 const char *ntpServer = NTP_SERVER;                         // NTP server
-constexpr unsigned long NTP_SYNC_DELAY_MS = 1000;           // Delay between NTP time sync attempts
+WiFiCache wifiCache;                                        // Last good channel, BSSID and IP lease, kept in NVS
+constexpr time_t VALID_TIME_EPOCH = 1700000000;             // An earlier system time means the clock was never set
+volatile bool isTimeSynced = false;                         // Set by the SNTP callback on the first time sync
+
+// * Runtime metrics, recorded on the hot paths and published every METRICS_INTERVAL_MS
+enum MetricTimer
+{
+    TimerSensorRead,   // DHT11 read
+    TimerJsonEncode,   // Building and serializing a telemetry document
+    TimerTlsWrite,     // One write or writev() to the TLS socket
+    TimerMqttPublish,  // Writing one MQTT PUBLISH, its TLS writev() included
+    TimerTlsHandshake, // connectAsync() to a finished TLS handshake
+    METRIC_TIMER_COUNT
+};
+enum MetricCounter
+{
+    CounterReconnects,        // MQTT connections after the first one
+    CounterHandshakeFailures, // TLS handshakes that failed
+    CounterDroppedSamples,    // Readings lost to a full queue, backlog or flash ring
+    CounterPublishFailures,   // Publishes that could not be written
+    METRIC_COUNTER_COUNT
+};
+const char *const METRIC_TIMER_NAMES[] = {"read", "json", "tls", "pub", "hs"};      // Keys in the metrics message
+const char *const METRIC_COUNTER_NAMES[] = {"reconn", "hsFail", "drop", "pubFail"}; // Keys in the metrics message
+static_assert(sizeof(METRIC_TIMER_NAMES) / sizeof(METRIC_TIMER_NAMES[0]) == METRIC_TIMER_COUNT, "One name per timer");
+static_assert(sizeof(METRIC_COUNTER_NAMES) / sizeof(METRIC_COUNTER_NAMES[0]) == METRIC_COUNTER_COUNT, "One name per counter");
+Metrics<METRIC_TIMER_COUNT, METRIC_COUNTER_COUNT> metrics; // Shared by the sensor and network tasks
+unsigned long lastMetricsTime = 0;                         // Last metrics message time
+int64_t handshakeStartUs = 0;                              // esp_timer_get_time() at connectAsync()
+bool hasConnectedMQTT = false;                             // Set by the first MQTT connection, later ones count as reconnects
+
+// WiFiClientSecure that times every write to the TLS socket
+class MeteredClientSecure : public WiFiClientSecure
+{
+public:
+    using WiFiClientSecure::write;
+
+    size_t write(const uint8_t *buf, size_t size) override
+    {
+        int64_t startUs = esp_timer_get_time();
+        size_t written = WiFiClientSecure::write(buf, size);
+        metrics.recordSince(TimerTlsWrite, startUs);
+        return written;
+    }
+
+    size_t writev(const tls_segment_t *segments, size_t count) // Called on this class by MqttSession, no virtual needed
+    {
+        int64_t startUs = esp_timer_get_time();
+        size_t written = WiFiClientSecure::writev(segments, count);
+        metrics.recordSince(TimerTlsWrite, startUs);
+        return written;
+    }
+};
 
 // * AWS IoT Core access settings
-WiFiClientSecure net = WiFiClientSecure();              // Create a WiFiClientSecure to handle the MQTT connection
-PubSubClient mqttClient(net);                           // Create a PubSubClient to handle the MQTT connection
+MeteredClientSecure net;                                // Create a WiFiClientSecure to handle the MQTT connection
 constexpr unsigned long MQTT_RECONNECT_DELAY_MS = 3000; // Delay between reconnect attempts
-String deviceID;                                        // Device ID for the AWS IoT Core
-String AWS_IOT_PUBLISH_TOPIC;                           // MQTT topic to publish messages
+constexpr uint16_t MQTT_KEEP_ALIVE_S = 60;              // PINGREQ after this long without traffic
+constexpr size_t MQTT_INFLIGHT_WINDOW = 4;              // QoS 1 batches sent before the first PUBACK is needed
+uint32_t nextDrainSequence = 0;                         // First ring sequence not yet sent on this session
+bool isAWSConnecting = false;                           // Flag for a TLS connection in progress
+unsigned long lastAWSConnectAttempt = 0;                // Last time a connection attempt was started
+char deviceID[17];                                      // Device ID for the AWS IoT Core, eFuse MAC in hex
+char AWS_IOT_PUBLISH_TOPIC[sizeof(deviceID) + 4];       // MQTT topic to publish messages, computed once
+char AWS_IOT_METRICS_TOPIC[sizeof(deviceID) + 8];       // MQTT topic to publish runtime metrics, computed once
+char AWS_IOT_SUMMARY_TOPIC[sizeof(deviceID) + 8];       // MQTT topic to publish the edge window summaries, computed once
+
+// * Firmware update settings, AWS IoT jobs with {"ota":{"url","size","signature","baseMd5"}} documents
+constexpr size_t MQTT_INBOUND_SIZE = OTA_ENABLED ? 3072 : 0; // Largest job message, a presigned URL included
+#if OTA_ENABLED
+WiFiClientSecure otaNet;                                 // Second TLS connection, to the image host
+OtaUpdater otaUpdater(otaNet);                           // Downloads, verifies and flashes the image of a job
+OtaJob otaJob;                                           // Job being run, only written while otaUpdater is not running
+bool isOtaJobPending = false;                            // otaJob received, serviceOta() starts it
+char AWS_IOT_JOBS_NOTIFY_TOPIC[sizeof(deviceID) + 30];   // Next queued job, pushed by AWS IoT jobs
+char AWS_IOT_JOBS_GET_TOPIC[sizeof(deviceID) + 30];      // Request for the next queued job
+char AWS_IOT_JOBS_ACCEPTED_TOPIC[sizeof(deviceID) + 40]; // Answer to the request
+#endif
+
+// * Offline telemetry buffer settings
+const char *TELEMETRY_PARTITION_LABEL = "spiffs";  // Data partition of the default partition table used as the ring
+constexpr size_t TELEMETRY_BUFFER_SECTORS = 16;    // 16 x 4 KB sectors, 3840 readings (~3 hours at 3 s) before overwrite
+TelemetryBuffer telemetryBuffer;                   // Readings waiting for the MQTT session to come back
+
+// * Status strings, indexed by SensorConditionStatus
+constexpr const char *CONDITION_STRINGS[] = {"Normal", "Below Normal", "Above Normal", "Sensor Error"};
+static_assert(sizeof(CONDITION_STRINGS) / sizeof(CONDITION_STRINGS[0]) == SensorError + 1, "One string per SensorConditionStatus");
+TelemetryEncoder telemetryEncoder(CONDITION_STRINGS, SensorError + 1); // Builds and encodes the telemetry document
+
+// * Telemetry batch settings
+constexpr size_t TELEMETRY_BATCH_CAPACITY = TELEMETRY_BATCH_SIZE;                        // Readings packed into one MQTT message
+constexpr unsigned long TELEMETRY_BATCH_TIMEOUT_MS = TELEMETRY_BATCH_INTERVAL_MS;        // Flush a partial batch after this time
+constexpr size_t MQTT_PAYLOAD_SIZE = 256 + TELEMETRY_BATCH_CAPACITY * 120;               // JSON bytes for a full batch, up to 116 per sample
+static_assert(MQTT_PAYLOAD_SIZE >= TelemetryEncoder::maxEncodedSize(TELEMETRY_BATCH_CAPACITY, TELEMETRY_BATCH_CAPACITY > 1), "A full batch of Sensor Error samples must fit the payload buffer");
+uint8_t mqttPayloadBuffer[MQTT_PAYLOAD_SIZE];                                            // Encoded payload, reused by every publish and written in place
+MqttSession<MQTT_INFLIGHT_WINDOW, MeteredClientSecure, MQTT_INBOUND_SIZE> mqttClient(net); // MQTT session on the TLS connection
+constexpr size_t JSON_ARENA_SIZE = 1536 + TELEMETRY_BATCH_CAPACITY * 256;                // Document memory for a full batch
+ArenaAllocator<JSON_ARENA_SIZE> jsonArena;                                               // Static document memory, reset by every publish
+static_assert(TELEMETRY_BATCH_CAPACITY >= 1, "TELEMETRY_BATCH_SIZE must be at least 1"); // A batch holds one reading or more
+typedef TelemetryPublisher<MqttSession<MQTT_INFLIGHT_WINDOW, MeteredClientSecure, MQTT_INBOUND_SIZE>, ArenaAllocator<JSON_ARENA_SIZE>> MqttTelemetryPublisher;
+constexpr MqttTelemetryPublisher::Format TELEMETRY_FORMAT = {TELEMETRY_BATCH_CAPACITY > 1, TELEMETRY_LEAN_PAYLOAD != 0, TELEMETRY_ENCODING == TELEMETRY_ENCODING_MSGPACK}; // Payload format of the build flags
+RTC_DATA_ATTR TelemetryRecord telemetryBatch[TELEMETRY_BATCH_CAPACITY];                  // Readings collected for the next message, kept in deep sleep
+RTC_DATA_ATTR size_t telemetryBatchCount = 0;                                            // Readings in telemetryBatch
+unsigned long telemetryBatchStartTime = 0;                                               // Time the first reading of the batch was taken
+uint8_t lastQueuedCondition = 0xFF;                                                      // Condition of the previous reading, a change flushes the batch at once
+std::atomic<bool> isRebootRequested{false};                                              // Set by the sensor task, the network task publishes the readings and reboots
+constexpr unsigned long REBOOT_FLUSH_TIMEOUT_MS = 5000;                                  // Longest wait for the last readings to be published before a reboot
 
 // * Initialize the DHT11
-DHT dht(DHT_PIN, DHT_TYPE); // Initialize DHT sensor
+DHT11Sensor dht(DHT_PIN); // Initialize DHT sensor
 
 // * Declare functions
-void checkSensorReadings(float &humidity, float &temperatureC, float &temperatureF);                              // Function to read and process sensor data
-void updateStatusLEDs(bool isRedOn, bool isGreenOn, bool isBlueOn);                                               // Function to update the RGB LED
+void checkSensorReadings(DHT11Reading &reading);                                                                  // Function to read and process sensor data
 void indicateNormalCondition();                                                                                   // Function to indicate normal conditions
 void indicateConditionBelowRange();                                                                               // Function to indicate condition below range
 void indicateConditionAboveRange();                                                                               // Function to indicate condition above range
 void indicateSensorError();                                                                                       // Function to indicate sensor error
-void blinkLEDs();                                                                                                 // Function to handle LED blinking and buzzer beeping
 void connectToWiFi();                                                                                             // Function to connect to WiFi
 void pingHost();                                                                                                  // Function to ping a host
-void syncNTP();                                                                                                   // Function to initialize NTP
+void syncNTP();                                                                                                   // Function to start the NTP time sync in the background
 void connectAWS();                                                                                                // Function to connect to AWS IoT Core
-void mqttPublishMessage(float humidity, float temperatureC, float temperatureF, SensorConditionStatus condition); // Function to publish message to AWS IoT Core
-String calculateTimezoneString(long offsetSec); // Function to determine the timezone string from the offset in seconds
-String checkDSTStatus(long dstOffsetSec);       // Function to check DST status based on DST offset
-String timezoneStr;                             // String to hold the timezone
-String dstStatus;                               // String to hold the DST status
+void serviceAWSConnection();                                                                                      // Function to advance the AWS IoT Core connection without blocking
+TelemetryRecord makeTelemetryRecord(float humidity, float temperatureC, SensorConditionStatus condition);         // Function to pack a reading into a telemetry record
+void queueTelemetryRecord(TelemetryRecord record);                                                                // Function to add a reading to the current batch
+void serviceTelemetryBatch();                                                                                     // Function to flush the batch once its interval has passed
+void flushTelemetryBatch();                                                                                       // Function to publish the batch or store it for later
+void drainTelemetryBuffer();                                                                                      // Function to publish buffered readings in batches
+const char *conditionToString(SensorConditionStatus condition);                                                   // Function to convert a condition to its status string
+MqttTelemetryPublisher::Status mqttPublishMessage(const TelemetryRecord *records, size_t count, bool confirmed);  // Function to publish message to AWS IoT Core
+void reportHeapUsage();                                                 // Function to report heap and payload memory usage
+void publishMetrics();                                                  // Function to publish the runtime metrics
+void postIndicatorEvent(IndicatorEvent event);                          // Function to hand an indication to the indicator task
+void indicateCondition(SensorConditionStatus condition);                // Function to show a condition on the LEDs and buzzer
+void sensorTask(void *parameter);                                       // Task sampling the DHT11 at an adaptive period
+void networkTask(void *parameter);                                      // Task owning the MQTT and TLS clients
+void takeQueuedReadings();                                              // Function to move the readings of the sensor task into the batch
+void rebootAfterFlush();                                                // Function to publish the pending readings, then reboot
+void indicatorTask(void *parameter);                                    // Task owning the LEDs and the buzzer
+void applyIndicatorEvent(IndicatorEvent event);                         // Function to drive the LEDs and buzzer for an indication
+void runDutyCycle();                                                    // Function to run one duty-cycled wake-up, ends in deep sleep
+bool connectForDutyCycle();                                             // Function to bring up Wi-Fi and AWS IoT Core with timeouts
+void configureWiFiAddress();                                            // Function to apply the static IP from build_flags, if any
+void onTimeSync(struct timeval *tv);                                    // Callback of the SNTP client on every time sync
+bool isClockSet();                                                      // Function to check if the system time is real time
+void serviceStartup();                                                  // Function to advance the startup pipeline by one stage
+void pingTask(void *parameter);                                         // Task running the one-off ping diagnostic
+bool startTask(TaskFunction_t task, const char *name, uint32_t stackSize, UBaseType_t priority, BaseType_t core, TaskHandle_t *handle); // Function to create a task on its core
+void onMqttMessage(const char *topic, const uint8_t *payload, size_t length); // Callback of the MQTT session for the AWS IoT jobs topics
+void serviceOta();                                                      // Function to start a received firmware job and report how it ends
+void publishJobStatus(const char *status, const char *reason);          // Function to report the firmware job state to AWS IoT jobs
+SensorConditionStatus edgeCondition();                                  // Function to map the confirmed aggregator state to a condition
+void postEdgeSummary(uint32_t nowMs);                                   // Function to hand the window summary to the network task
+void publishEdgeSummary(const EdgeSummary &summary);                    // Function to publish one window summary
+size_t appendWindowStats(char *out, size_t size, const char *name, const EdgeWindowStats &stats); // Function to format the statistics of one quantity
+void calculateTimezoneString(long offsetSec, char *buffer, size_t size); // Function to determine the timezone string from the offset in seconds
+const char *checkDSTStatus(long dstOffsetSec);                           // Function to check DST status based on DST offset
+char timezoneStr[10];                                                    // String to hold the timezone
+TimeService timeService;                                                 // Cached local date and time strings of the payload
+MqttTelemetryPublisher telemetryPublisher(telemetryEncoder, jsonArena, mqttPayloadBuffer, sizeof(mqttPayloadBuffer), timeService, mqttClient); // Builds, encodes and publishes the readings
+const char *dstStatus;                                                   // String to hold the DST status
+
+// * FreeRTOS task settings
+constexpr uint32_t SENSOR_TASK_STACK_SIZE = 4096;                  // Stack for the DHT11 read and serial printing
+constexpr uint32_t NETWORK_TASK_STACK_SIZE = 8192;                 // Stack for the TLS handshake and MQTT publish
+constexpr uint32_t INDICATOR_TASK_STACK_SIZE = 3072;               // Stack for the LEDC writes
+constexpr UBaseType_t INDICATOR_TASK_PRIORITY = 3;                 // Alarms first, a blocked LED would hide a condition
+constexpr UBaseType_t SENSOR_TASK_PRIORITY = 2;                    // Sampling preempts networking to keep its period
+constexpr UBaseType_t NETWORK_TASK_PRIORITY = 1;                   // Networking runs whenever the others wait
+constexpr UBaseType_t TELEMETRY_QUEUE_LENGTH = 16;                 // Readings the network task may fall behind by (48 s)
+constexpr unsigned long NETWORK_TASK_POLL_MS = 10;                 // Longest wait for a reading before servicing the connection
+SpscQueue<TelemetryRecord, TELEMETRY_QUEUE_LENGTH> telemetryQueue; // Readings from the sensor task to the network task
+TaskHandle_t networkTaskHandle = NULL;                             // Notified by the sensor task for every queued reading
+QueueHandle_t indicatorQueue = NULL;                               // Latest indicator event, overwritten by the sensor task
+
+// * Core placement, with TASK_CORE_PINNING=1 mbedtls and the Wi-Fi driver never delay a DHT11 transaction
+constexpr BaseType_t PROTOCOL_CORE = 0;                                      // Core of the Wi-Fi driver and lwIP: network, ping and OTA tasks
+constexpr BaseType_t APPLICATION_CORE = portNUM_PROCESSORS - 1;              // Core of the Arduino loop: sensor and indicator tasks
+constexpr bool IS_CORE_PINNED = TASK_CORE_PINNING && portNUM_PROCESSORS > 1; // Single-core chips such as the C3 and C6 keep every task unpinned
+
+// * Startup pipeline, sampling starts at once and the network comes up behind it
+enum StartupStage
+{
+    StartupConnectingWiFi, // Associating, readings wait in the telemetry queue
+    StartupSyncingTime,    // SNTP and the TLS handshake run in parallel, readings wait in the pre-sync backlog
+    StartupOnline,         // Clock set, readings flow to the batch
+};
+StartupStage startupStage = StartupConnectingWiFi;     // Current stage, owned by the network task
+constexpr uint32_t PING_TASK_STACK_SIZE = 4096;        // Stack for the ICMP echo
+constexpr size_t PRE_SYNC_BACKLOG_SIZE = 64;           // Readings held until the first time sync (~3 minutes at 3 s)
+TelemetryRecord preSyncBacklog[PRE_SYNC_BACKLOG_SIZE]; // Readings stamped with seconds since boot, fixed up on sync
+size_t preSyncBacklogCount = 0;                        // Readings in preSyncBacklog
+unsigned long firstPublishTime = 0;                    // millis() of the first successful publish, 0 before it
+
+// * Duty-cycled mode settings, the RTC_DATA_ATTR state survives deep sleep
+constexpr unsigned long DUTY_WIFI_TIMEOUT_MS = 5000;  // Longest wait for one Wi-Fi association attempt
+constexpr unsigned long DUTY_AWS_TIMEOUT_MS = 10000;  // Longest wait for the TLS and MQTT connection
+constexpr unsigned long DUTY_NTP_TIMEOUT_MS = 5000;   // Longest wait for the first NTP time sync
+constexpr unsigned long DUTY_MIN_SLEEP_MS = 100;      // Shortest deep sleep when a cycle ran over its interval
+RTC_DATA_ATTR uint8_t rtcLastCondition = 0xFF;        // Condition of the previous wake-up, 0xFF before the first
+RTC_DATA_ATTR uint32_t rtcCycleCount = 0;             // Wake-ups since power-on
+RTC_DATA_ATTR uint32_t rtcMaxAwakeMs = 0;             // Longest wake-to-sleep time since power-on
+
+// * Heap usage report settings
+constexpr unsigned long HEAP_REPORT_INTERVAL_MS = 60000; // Interval between heap usage reports
+unsigned long lastHeapReportTime = 0;                    // Last heap usage report time
+int32_t maxPublishHeapDelta = 0;                         // Largest free heap drop across one publish
 
 // **********************************
 // & Setup Function
@@ -155,23 +530,46 @@ String dstStatus;                               // String to hold the DST status
 void setup()
 {
     Serial.begin(115200); // Initialize serial communication
+    LOG_BEGIN();          // Start draining the log ring to Serial
 
-    Serial.println("Initializing system......");
+    LOG_INFO("Initializing system......");
 
-    HardwareInfo::displayHardwareInfo(); // Display hardware information
-
-    deviceID = String(ESP.getEfuseMac(), HEX); // Get the device ID
-    AWS_IOT_PUBLISH_TOPIC = deviceID + "/pub"; // Set the MQTT topic to publish messages
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER) // Skip on duty-cycle wake-ups to save awake time
+    {
+        LOG_FLUSH();                         // HardwareInfo prints straight to Serial, keep the order
+        HardwareInfo::displayHardwareInfo(); // Display hardware information
+    }
 
-    timezoneStr = calculateTimezoneString(GMT_OFFSET_SEC); // Calculate timezone string without DST consideration
+    snprintf(deviceID, sizeof(deviceID), "%llx", ESP.getEfuseMac());                       // Get the device ID
+    snprintf(AWS_IOT_PUBLISH_TOPIC, sizeof(AWS_IOT_PUBLISH_TOPIC), "%s/pub", deviceID);     // Set the MQTT topic to publish messages
+    snprintf(AWS_IOT_METRICS_TOPIC, sizeof(AWS_IOT_METRICS_TOPIC), "%s/metrics", deviceID); // Set the MQTT topic to publish runtime metrics
+    snprintf(AWS_IOT_SUMMARY_TOPIC, sizeof(AWS_IOT_SUMMARY_TOPIC), "%s/summary", deviceID); // Set the MQTT topic to publish the window summaries
+#if OTA_ENABLED
+    snprintf(AWS_IOT_JOBS_NOTIFY_TOPIC, sizeof(AWS_IOT_JOBS_NOTIFY_TOPIC), "$aws/things/%s/jobs/notify-next", deviceID);
+    snprintf(AWS_IOT_JOBS_GET_TOPIC, sizeof(AWS_IOT_JOBS_GET_TOPIC), "$aws/things/%s/jobs/$next/get", deviceID);
+    snprintf(AWS_IOT_JOBS_ACCEPTED_TOPIC, sizeof(AWS_IOT_JOBS_ACCEPTED_TOPIC), "%s/accepted", AWS_IOT_JOBS_GET_TOPIC);
+    mqttClient.setCallback(onMqttMessage); // Job messages arrive through mqttClient.loop()
+    if (!otaUpdater.begin(OTA_SIGNING_PUBLIC_KEY))
+        LOG_WARN("OTA signing key unusable, firmware jobs are refused");
+#endif
+
+    calculateTimezoneString(GMT_OFFSET_SEC, timezoneStr, sizeof(timezoneStr)); // Calculate timezone string without DST consideration
     dstStatus = checkDSTStatus(DST_OFFSET_SEC);
 
     dht.begin(); // Initialize the DHT sensor
 
+    // Recover readings buffered before the last reboot
+    if (telemetryBuffer.begin(TELEMETRY_PARTITION_LABEL, TELEMETRY_BUFFER_SECTORS))
+    {
+        LOG_INFO("Telemetry buffer ready, pending readings: %u", (unsigned)telemetryBuffer.size());
+    }
+    else
+    {
+        LOG_WARN("Telemetry buffer partition not found, readings are only published live");
+    }
+
     // Set Data LED pins as output
-    pinMode(DATA_LED_ABOVE_RED, OUTPUT);    // Set LED RED pin as output
-    pinMode(DATA_LED_NORMAL_GREEN, OUTPUT); // Set LED GREEN pin as output
-    pinMode(DATA_LED_BELOW_BLUE, OUTPUT);   // Set LED BLUE pin as output
+    indicatorOutputs.begin(); // pinMode() of the RGB LED pins
 
     // Setup and Attach PWM channels to System LED D4
     ledcSetup(SYS_LED_D4_CHANNEL, SYS_LED_FREQ, SYS_LED_RESOLUTION); // Setup LEDC channel for LED D4
@@ -185,13 +583,38 @@ void setup()
     ledcSetup(BUZZER_CHANNEL, BUZZER_FREQ, BUZZER_RESOLUTION); // Setup LEDC channel for Piezo Buzzer
     ledcAttachPin(BUZZER_PIN, BUZZER_CHANNEL);                 // Attach Piezo Buzzer to PWM channel
 
-    Serial.println("DHT11 sensor monitoring started."); // Inform the user that monitoring has started
+    if (!indicatorEngine.begin()) // Create the timer that plays the indicator patterns
+        LOG_WARN("Failed to create the indicator timer, conditions are not shown");
 
-    connectToWiFi(); // Connect to WiFi
-    pingHost();      // Ping the host
-    syncNTP();       // Initialize NTP
-    configTime(GMT_OFFSET_SEC, DST_OFFSET_SEC, ntpServer);
-    connectAWS(); // Connect to AWS IoT Core
+    LOG_INFO("DHT11 sensor monitoring started."); // Inform the user that monitoring has started
+
+#if DUTY_CYCLE_MODE
+    runDutyCycle(); // Sample, publish if needed and deep sleep, setup() runs again on the next wake-up
+#endif
+
+    // Create the indicator mailbox, the telemetry and summary queues are static
+    indicatorQueue = xQueueCreate(1, sizeof(IndicatorEvent)); // Length 1 for xQueueOverwrite()
+    if (indicatorQueue == NULL)
+    {
+        LOG_ERROR("Failed to create task queues. Rebooting...");
+        delay(ESP32_REBOOT_DELAY_MS);
+        ESP.restart();
+    }
+
+    // Start the tasks, sampling begins now and the network task brings up Wi-Fi, NTP and AWS IoT Core
+    if (IS_CORE_PINNED)
+        LOG_INFO("Tasks: network on core %d, sensor and indicator on core %d", (int)PROTOCOL_CORE, (int)APPLICATION_CORE);
+    else
+        LOG_INFO("Tasks: unpinned on %d core(s)", (int)portNUM_PROCESSORS);
+    bool isStarted = startTask(indicatorTask, "indicator", INDICATOR_TASK_STACK_SIZE, INDICATOR_TASK_PRIORITY, APPLICATION_CORE, NULL);
+    isStarted &= startTask(networkTask, "network", NETWORK_TASK_STACK_SIZE, NETWORK_TASK_PRIORITY, PROTOCOL_CORE, &networkTaskHandle);
+    isStarted &= startTask(sensorTask, "sensor", SENSOR_TASK_STACK_SIZE, SENSOR_TASK_PRIORITY, APPLICATION_CORE, NULL); // Last, it notifies the network task
+    if (!isStarted)
+    {
+        LOG_ERROR("Failed to create the tasks. Rebooting...");
+        delay(ESP32_REBOOT_DELAY_MS);
+        ESP.restart();
+    }
 }
 
 // **********************************
@@ -199,169 +622,98 @@ void setup()
 // **********************************
 void loop()
 {
-    static float humidity = 0;
-    static float temperatureC = 0;
-    static float temperatureF = 0;
-    unsigned long currentMillis = millis();
-
-    if (currentMillis - lastCheckTime >= SENSOR_READ_INTERVAL)
-    {
-        lastCheckTime = currentMillis;
-        checkSensorReadings(humidity, temperatureC, temperatureF); // Read sensor and update humidity and temperature
-
-        if (!isnan(humidity) && !isnan(temperatureC)) // Check if the readings are valid
-        {
-            // Reset sensor error count upon successful reading
-            sensorErrorCount = 0;
-
-            // Publish message to AWS IoT Core
-            mqttPublishMessage(humidity, temperatureC, temperatureF, currentCondition);
-        }
-        else
-        {
-            // Handle sensor errors
-            sensorErrorCount++; // Increment sensor error count
-            if (sensorErrorCount >= MAX_SENSOR_ERROR_RETRIES)
-            {
-                Serial.println("Maximum sensor error retries reached. Rebooting...");
-                delay(ESP32_REBOOT_DELAY_MS);
-                ESP.restart(); // Reboot the device
-            }
-            // Publish sensor error to AWS IoT Core
-            mqttPublishMessage(NAN, NAN, NAN, currentCondition); //
-        }
-    }
-
-    blinkLEDs(); // Handle LED blinking and buzzer beeping
+    vTaskDelete(NULL); // All work runs in the tasks started by setup()
 }
 
 // **********************************
 // & Functions  Definition
 // **********************************
-void checkSensorReadings(float &humidity, float &temperatureC, float &temperatureF)
+void checkSensorReadings(DHT11Reading &reading)
 {
-    humidity = dht.readHumidity();            // Read humidity
-    temperatureC = dht.readTemperature();     // Read temperature in Celsius
-    temperatureF = dht.readTemperature(true); // Read temperature in Fahrenheit
+    reading = dht.read(); // Read humidity and temperature in one bus transaction
+
+    // A corrupted frame is usually a one-off, retry once before counting it as an error
+    if (reading.status == DHT11_TIMING_ERROR || reading.status == DHT11_CHECKSUM_ERROR)
+    {
+        LOG_WARN("DHT11 %s, retrying", DHT11Sensor::statusToString(reading.status));
+        delay(DHT11Sensor::MIN_READ_INTERVAL_MS); // The sensor needs a pause between transactions
+        reading = dht.read();
+    }
+    metrics.record(TimerSensorRead, reading.latencyUs); // Failed transactions included, they hold the task as long
+
+    float humidity = reading.humidity;
+    float temperatureC = reading.temperatureC;
 
     // Validation and action based on the read values
-    if (isnan(humidity) || isnan(temperatureC) || isnan(temperatureF)) // Check if any of the readings are NaN
+    if (reading.status != DHT11_OK) // Check if the transaction failed
     {
-        indicateSensorError();          // Indicate sensor error
+        LOG_WARN("DHT11 read failed: %s", DHT11Sensor::statusToString(reading.status));
         currentCondition = SensorError; // Set current condition to Error
     }
     else
     {
-        Serial.print("Humidity: ");
-        Serial.print(humidity);
-        Serial.print("%, Temp: ");
-        Serial.print(temperatureC);
-        Serial.print("C / ");
-        Serial.print(temperatureF);
-        Serial.println("F");
+        LOG_INFO("Humidity: %.2f%%, Temp: %.2fC / %.2fF, read in %lu us", humidity, temperatureC, reading.temperatureF, (unsigned long)reading.latencyUs);
 
-        // Condition indications based on readings
+        // Condition based on readings, shown by the caller
         if (temperatureC >= TEMP_MIN && temperatureC <= TEMP_MAX && humidity >= HUM_MIN && humidity <= HUM_MAX) // Check if readings are within normal range
         {
-            indicateNormalCondition(); // Indicate normal condition
             currentCondition = Normal; // Set current condition to Normal
         }
         else if (temperatureC < TEMP_MIN || humidity < HUM_MIN) // Check if readings are below normal range
 
         {
-            indicateConditionBelowRange();  // Indicate condition below range
             currentCondition = BelowNormal; // Set current condition to BelowNormal
         }
         else
         {
-            indicateConditionAboveRange();  // Indicate condition above range
             currentCondition = AboveNormal; // Set current condition to AboveNormal
         }
     }
 }
 
-void updateStatusLEDs(bool isRedOn, bool isGreenOn, bool isBlueOn) // Function to update the RGB LED
-{
-    digitalWrite(DATA_LED_ABOVE_RED, isRedOn ? HIGH : LOW);      // Turn on or off the red LED
-    digitalWrite(DATA_LED_NORMAL_GREEN, isGreenOn ? HIGH : LOW); // Turn on or off the green LED
-    digitalWrite(DATA_LED_BELOW_BLUE, isBlueOn ? HIGH : LOW);    // Turn on or off the blue LED
-}
-
 void indicateNormalCondition() // Function to indicate normal conditions
 {
-    isBlinkingEnabled = false;                  // Stop blinking
-    updateStatusLEDs(false, true, false);       // Turn on GREEN LED, off others
-    ledcWrite(SYS_LED_D5_CHANNEL, SYS_LED_OFF); // Turn LED D5 off
-    ledcWrite(BUZZER_CHANNEL, BUZZER_OFF);      // Mute the buzzer
-    Serial.println("Current LED Color: GREEN"); // Print current LED color
+    indicatorEngine.play(NORMAL_PATTERN); // Turn on GREEN LED, off others, LED D5 and buzzer off
+    LOG_INFO("Current LED Color: GREEN"); // Print current LED color
 }
 
 void indicateConditionBelowRange() // Function to indicate condition below range
 {
-    isBlinkingEnabled = true;                           // Indicate that the blue LED should blink
-    ledcWrite(SYS_LED_D5_CHANNEL, SYS_LED_OFF);         // Turn LED D5 off
-    blinkingLED = DATA_LED_BELOW_BLUE;                  // Blink the blue LED
-    Serial.println("Current LED Color: BLUE Blinking"); // Updated print statement
+    indicatorEngine.play(BELOW_RANGE_PATTERN);    // Blink the blue LED with the buzzer, LED D5 off
+    LOG_INFO("Current LED Color: BLUE Blinking"); // Updated print statement
 }
 
 void indicateConditionAboveRange() // Function to indicate condition above range
 {
-    isBlinkingEnabled = true;                          // Indicate that the red LED should blink
-    ledcWrite(SYS_LED_D5_CHANNEL, SYS_LED_OFF);        // Turn LED D5 off
-    blinkingLED = DATA_LED_ABOVE_RED;                  // Blink the red LED
-    Serial.println("Current LED Color: RED Blinking"); // Updated print statement
+    indicatorEngine.play(ABOVE_RANGE_PATTERN);   // Blink the red LED with the buzzer, LED D5 off
+    LOG_INFO("Current LED Color: RED Blinking"); // Updated print statement
 }
 
 void indicateSensorError() // Function to indicate sensor error
 {
-    isBlinkingEnabled = false;                     // Stop blinking
-    updateStatusLEDs(false, false, false);         // Turn off all LEDs
-    ledcWrite(SYS_LED_D5_CHANNEL, SYS_LED_ON);     // Turn LED D5 solid red
-    ledcWrite(BUZZER_CHANNEL, BUZZER_VOLUME_HALF); // Set buzzer to half volume
-    Serial.println("Sensor Error!");               // Print sensor error message
+    indicatorEngine.play(SENSOR_ERROR_PATTERN); // Turn off all data LEDs, LED D5 solid red, buzzer at half volume
+    LOG_WARN("Sensor Error!");                  // Print sensor error message
 }
 
-void blinkLEDs() // Function to handle LED blinking and buzzer beeping
+void connectToWiFi() // Function to connect to WiFi
 {
-    if (!isBlinkingEnabled) // Check if blinking is not enabled
-        return;             // Exit if blinking is not enabled
+    LOG_INFO("Connecting to WiFi...");
+    unsigned long connectStart = millis();
+    WiFi.mode(WIFI_STA);    // Set WiFi mode to station to connect to a WiFi network
+    configureWiFiAddress(); // Skip DHCP when a static IP is configured
 
-    unsigned long currentMillis = millis();                          // Get current time
-    if (currentMillis - lastBlinkTime >= DATA_LED_BLINK_INTERVAL_MS) // Check if it's time to toggle the LED state
+    // Directed association to the last good access point skips the channel scan
+    if (!wifiCache.connectCached(ssid, password, WIFI_FAST_CONNECT_TIMEOUT_MS, WIFI_USE_CACHED_LEASE))
     {
-        lastBlinkTime = currentMillis; // Update the last blink time
-        static bool ledState = false;  // Toggle state variable
-        ledState = !ledState;          // Toggle the state
-
-        // Determine which LED to blink based on the condition
-        if (blinkingLED == DATA_LED_BELOW_BLUE)
-        {
-            updateStatusLEDs(false, false, ledState); // Blink Blue LED for below range
-        }
-        else if (blinkingLED == DATA_LED_ABOVE_RED)
-        {
-            updateStatusLEDs(ledState, false, false); // Blink Red LED for above range
-        }
-
-        // Synchronize the buzzer beeping with LED blinking
-        ledcWrite(BUZZER_CHANNEL, ledState ? BUZZER_VOLUME_HALF : BUZZER_OFF);
+        LOG_INFO("No cached access point, scanning...");
+        WiFi.begin(ssid, password); // Start the connection process with a full scan
     }
-}
-
-void connectToWiFi() // Function to connect to WiFi
-{
-    Serial.println("Connecting to WiFi...");
-    WiFi.mode(WIFI_STA);        // Set WiFi mode to station to connect to a WiFi network
-    WiFi.begin(ssid, password); // Start the connection process
 
     int attempts = 0;                                                             // Initialize the number of connection attempts
-    while (WiFi.status() != WL_CONNECTED && attempts < MAX_WIFI_CONNECT_ATTEMPTS) // Check if WiFi is not connected and the number of attempts is less than the maximum
+    while (attempts < MAX_WIFI_CONNECT_ATTEMPTS && !WiFiCache::waitForConnection(WIFI_CONNECT_RETRY_DELAY_MS)) // Wait up to 5 seconds per attempt, returns as soon as WiFi is connected
     {
-        delay(WIFI_CONNECT_RETRY_DELAY_MS); // Wait 5 seconds between attempts
         attempts++;
-        Serial.print("Attempt ");
-        Serial.print(attempts);
-        Serial.println(": Trying to connect to WiFi...");
+        LOG_WARN("Attempt %d: Trying to connect to WiFi...", attempts);
 
         if (attempts >= 1) // Check if the number of attempts is greater than or equal to 1
         {
@@ -374,22 +726,19 @@ void connectToWiFi() // Function to connect to WiFi
     if (WiFi.status() == WL_CONNECTED) // Check if WiFi is connected
     {
         // If connected successfully, turn off LED D4 and print the IP address and RSSI
-        Serial.println("Connected to WiFi successfully!");
-        Serial.print("WiFi SSID: ");
-        Serial.println(WiFi.SSID());
-        Serial.print("IP Address: ");
-        Serial.println(WiFi.localIP());
+        LOG_INFO("Connected to WiFi successfully in %lu ms!", millis() - connectStart);
+        wifiCache.save(); // Remember the access point and lease for the next boot
+        LOG_INFO("WiFi SSID: %s", WiFi.SSID().c_str());
+        LOG_INFO("IP Address: %s", WiFi.localIP().toString().c_str());
         long rssi = WiFi.RSSI();
-        Serial.print("RSSI: ");
-        Serial.print(rssi);
-        Serial.println(" dBm");
+        LOG_INFO("RSSI: %ld dBm", rssi);
         ledcWrite(SYS_LED_D4_CHANNEL, SYS_LED_OFF); // Turn off LED D4 when WiFi is connected
         ledcWrite(BUZZER_CHANNEL, BUZZER_OFF);      // Mute the buzzer when WiFi is connected
     }
     else
     {
         // If connection failed after 3 attempts, keep LED D4 on to indicate failure
-        Serial.println("Failed to connect to WiFi. Rebooting...");
+        LOG_ERROR("Failed to connect to WiFi. Rebooting...");
         delay(ESP32_REBOOT_DELAY_MS); // Delay to allow the serial message to be sent before rebooting
         ESP.restart();                // Reboot the ESP32
     }
@@ -397,54 +746,56 @@ void connectToWiFi() // Function to connect to WiFi
 
 void pingHost() // Function to ping a host
 {
-    Serial.print("Pinging host: " + String(host) + "...");
-
     if (Ping.ping(host))
     {
-        Serial.println("Ping successful.");
+        LOG_INFO("Pinging host: %s...Ping successful.", host);
     }
     else
     {
-        Serial.println("Ping failed.");
+        LOG_WARN("Pinging host: %s...Ping failed.", host);
     }
 }
 
-void syncNTP() // Function to synchronize the NTP time
+void syncNTP() // Function to start the NTP time sync in the background
 {
-    Serial.println("Synchronizing NTP now..."); // Display the message
+    LOG_INFO("Synchronizing NTP now..."); // Display the message
 
-    // Initialize and start the SNTP service.
+    // Initialize and start the SNTP service, onTimeSync() reports the result
+    sntp_set_time_sync_notification_cb(onTimeSync);
     configTime(GMT_OFFSET_SEC, DST_OFFSET_SEC, ntpServer);
+}
 
-    // Wait for time to be set
-    Serial.println("Waiting for NTP time sync...");
-    struct tm timeinfo;
-    while (!getLocalTime(&timeinfo))
-    {
-        Serial.println("Fetching NTP time...");
-        delay(NTP_SYNC_DELAY_MS);
-    }
+void onTimeSync(struct timeval *tv) // Callback of the SNTP client on every time sync
+{
+    if (isTimeSynced)
+        return; // Only the first sync is reported
+    isTimeSynced = true;
 
-    // Once synchronized, print the current time
+    // Print the synchronized time
+    struct tm timeinfo;
+    time_t now = tv->tv_sec;
+    localtime_r(&now, &timeinfo);
     char timeStr[64];
     strftime(timeStr, sizeof(timeStr), "%A, %B %d %Y %H:%M:%S", &timeinfo);
-    Serial.println(timeStr);
+    LOG_INFO("%s", timeStr);
+}
+
+bool isClockSet() // Function to check if the system time is real time
+{
+    return isTimeSynced || time(nullptr) >= VALID_TIME_EPOCH; // The RTC keeps the time across deep sleep and software resets
 }
 
 // Function to determine the timezone string from the offset in seconds
-// Function to determine the timezone string from the offset in seconds
-String calculateTimezoneString(long offsetSec)
+void calculateTimezoneString(long offsetSec, char *buffer, size_t size)
 {
-    char buffer[10];
     // Calculate the total offset in hours
     float totalOffset = offsetSec / 3600.0;
     // Format as a string with a sign, e.g., "+02:00"
-    snprintf(buffer, sizeof(buffer), "%+03.0f:00", totalOffset);
-    return String(buffer);
+    snprintf(buffer, size, "%+03.0f:00", totalOffset);
 }
 
 // Function to check DST status based on DST offset
-String checkDSTStatus(long dstOffsetSec)
+const char *checkDSTStatus(long dstOffsetSec)
 {
     return dstOffsetSec > 0 ? "Yes" : "No";
 }
@@ -452,91 +803,818 @@ String checkDSTStatus(long dstOffsetSec)
 void connectAWS() // Function to connect to AWS IoT Core
 {
     // Configure WiFiClientSecure to use the AWS IoT device credentials
-    net.setCACert(AWS_ROOT_CA);         // Set the AWS Root CA certificate
+#if AWS_USE_CA_BUNDLE
+    net.setCACertBundle(AWS_CA_BUNDLE_START, AWS_CA_BUNDLE_END - AWS_CA_BUNDLE_START); // Only the matching root is parsed, during verification
+#elif AWS_CREDENTIALS_DER
+    net.setCACertDER(AWS_ROOT_CA_DER, sizeof(AWS_ROOT_CA_DER)); // Set the AWS Root CA certificate, referenced in flash
+#else
+    net.setCACert(AWS_ROOT_CA); // Set the AWS Root CA certificate
+#endif
+#if AWS_CREDENTIALS_DER
+    net.setCertificateDER(AWS_CERT_CRT_DER, sizeof(AWS_CERT_CRT_DER));      // Set the device certificate, referenced in flash
+    net.setPrivateKeyDER(AWS_PRIVATE_KEY_DER, sizeof(AWS_PRIVATE_KEY_DER)); // Set the private key, no base64 decode
+#else
     net.setCertificate(AWS_CERT_CRT);   // Set the device certificate
     net.setPrivateKey(AWS_PRIVATE_KEY); // Set the private key
+#endif
+    if (!net.setMaxFragmentLength(TLS_MAX_FRAGMENT_LENGTH))
+        LOG_WARN("Invalid TLS_MAX_FRAGMENT_LENGTH, using 16 KB records");
+    net.setCredentialCache(true); // Keep the parsed credentials for reconnects
+    net.setSessionCache(true);    // Resume the TLS session on reconnects
+
+#if OTA_ENABLED
+    // S3 presents an Amazon Trust Services chain as well, the image host shares the root
+#if AWS_USE_CA_BUNDLE
+    otaNet.setCACertBundle(AWS_CA_BUNDLE_START, AWS_CA_BUNDLE_END - AWS_CA_BUNDLE_START);
+#elif AWS_CREDENTIALS_DER
+    otaNet.setCACertDER(AWS_ROOT_CA_DER, sizeof(AWS_ROOT_CA_DER));
+#else
+    otaNet.setCACert(AWS_ROOT_CA);
+#endif
+#endif
+
+    serviceAWSConnection(); // Start the first connection attempt
+}
+
+void serviceAWSConnection() // Function to advance the AWS IoT Core connection without blocking
+{
+    if (isAWSConnecting) // Check if a TLS handshake is in progress
+    {
+        tls_connect_status_t status = net.poll(); // Step the TCP connect or TLS handshake once
+        if (status == TLS_CONNECT_PENDING)
+            return; // Come back on the next loop iteration
+
+        isAWSConnecting = false;
+        if (status == TLS_CONNECT_FAILED)
+        {
+            LOG_WARN("AWS IoT Core connection is failed!");
+            metrics.increment(CounterHandshakeFailures);
+            return;
+        }
+        metrics.recordSince(TimerTlsHandshake, handshakeStartUs);
+
+        // TLS is up, the MQTT session only sends CONNECT on the open connection
+        if (mqttClient.connect(deviceID, MQTT_KEEP_ALIVE_S))
+        {
+            LOG_INFO("AWS IoT Core is connected successfully!");
+            nextDrainSequence = telemetryBuffer.oldestSequence(); // Resend whatever the old session left unconfirmed
+            if (hasConnectedMQTT)
+                metrics.increment(CounterReconnects);
+            hasConnectedMQTT = true;
+#if OTA_ENABLED
+            mqttClient.subscribe(AWS_IOT_JOBS_NOTIFY_TOPIC);                       // Jobs queued from now on
+            mqttClient.subscribe(AWS_IOT_JOBS_ACCEPTED_TOPIC);                     // Answer to the request below
+            mqttClient.publish(AWS_IOT_JOBS_GET_TOPIC, (const uint8_t *)"{}", 2); // Ask for a job queued while offline
+#endif
+        }
+        else
+        {
+            LOG_WARN("MQTT connect failed, rc=%d", mqttClient.state());
+        }
+        return;
+    }
+
+    if (mqttClient.connected()) // Nothing to do while the session is up
+        return;
+
+    unsigned long currentMillis = millis();
+    if (lastAWSConnectAttempt != 0 && currentMillis - lastAWSConnectAttempt < MQTT_RECONNECT_DELAY_MS)
+        return; // Wait between reconnect attempts
+    lastAWSConnectAttempt = currentMillis;
+
+    LOG_INFO("Connecting to AWS IOT Core");
+    handshakeStartUs = esp_timer_get_time();
+    isAWSConnecting = net.connectAsync(AWS_IOT_MQTT_SERVER, AWS_IOT_MQTT_PORT); // Returns right after opening the socket
+}
+
+TelemetryRecord makeTelemetryRecord(float humidity, float temperatureC, SensorConditionStatus condition) // Function to pack a reading into a telemetry record
+{
+    TelemetryRecord record = {};
+    if (isClockSet())
+    {
+        record.timestamp = time(nullptr); // Stamp at sampling time so buffered readings keep their real time
+    }
+    else
+    {
+        record.timestamp = esp_timer_get_time() / 1000000; // Seconds since boot, queueTelemetryRecord() fixes it up after the sync
+        record.flags |= TELEMETRY_FLAG_UNSYNCED;
+    }
+    record.temperatureC = encodeTelemetryValue(temperatureC);
+    record.humidity = encodeTelemetryValue(humidity);
+    record.condition = condition;
+    return record;
+}
+
+void queueTelemetryRecord(TelemetryRecord record) // Function to add a reading to the current batch
+{
+    if (record.flags & TELEMETRY_FLAG_UNSYNCED) // Sampled before the clock was set
+    {
+        if (!isClockSet()) // Hold it until the sync, flash must only hold real time stamps
+        {
+            if (preSyncBacklogCount < PRE_SYNC_BACKLOG_SIZE)
+                preSyncBacklog[preSyncBacklogCount++] = record;
+            else
+            {
+                LOG_WARN("Pre-sync backlog full, reading dropped");
+                metrics.increment(CounterDroppedSamples);
+            }
+            return;
+        }
+        record.timestamp += time(nullptr) - esp_timer_get_time() / 1000000; // Boot time in Unix time plus seconds since boot
+        record.flags &= ~TELEMETRY_FLAG_UNSYNCED;
+    }
+
+    if (telemetryBatchCount == 0)
+        telemetryBatchStartTime = millis(); // The batch interval starts with its first reading
 
-    // Set the AWS IoT endpoint and port
-    mqttClient.setServer(AWS_IOT_MQTT_SERVER, AWS_IOT_MQTT_PORT);
+    telemetryBatch[telemetryBatchCount++] = record;
+    if (telemetryBatchCount >= TELEMETRY_BATCH_CAPACITY) // Publish as soon as the batch is full
+        flushTelemetryBatch();
+}
 
-    Serial.println("Connecting to AWS IOT Core");
+void serviceTelemetryBatch() // Function to flush the batch once its interval has passed
+{
+    if (telemetryBatchCount > 0 && millis() - telemetryBatchStartTime >= TELEMETRY_BATCH_TIMEOUT_MS)
+        flushTelemetryBatch();
+}
+
+void flushTelemetryBatch() // Function to publish the batch or store it for later
+{
+    size_t count = telemetryBatchCount;
+    telemetryBatchCount = 0;
+    if (count == 0)
+        return;
 
-    while (!mqttClient.connect(deviceID.c_str())) // Connect to AWS IoT Core
+    // Publish directly only when nothing older is waiting, so readings stay in order.
+    // With QoS 1 the batch goes through the ring, which keeps it until the PUBACK.
+    bool isLive = !MQTT_QOS || !telemetryBuffer.isAvailable();
+    if (isLive && telemetryBuffer.isEmpty() && mqttPublishMessage(telemetryBatch, count, false) == MqttTelemetryPublisher::Published)
+        return;
+
+    for (size_t i = 0; i < count; i++)
     {
-        Serial.print(".");
-        delay(MQTT_RECONNECT_DELAY_MS);
+        if (!telemetryBuffer.push(telemetryBatch[i]))
+        {
+            LOG_WARN("Telemetry buffer write failed, reading dropped");
+            metrics.increment(CounterDroppedSamples);
+        }
     }
+    LOG_INFO("Readings buffered, pending readings: %u", (unsigned)telemetryBuffer.size());
+}
 
-    if (!mqttClient.connected()) // Check if the client is connected
+void drainTelemetryBuffer() // Function to publish buffered readings in batches
+{
+    uint32_t confirmed;
+    while (mqttClient.takeConfirmed(confirmed)) // Commit QoS 1 batches in order once the broker holds them
     {
-        Serial.println("AWS IoT Core connection is failed!");
+        telemetryBuffer.release(confirmed);
+        LOG_INFO("Buffered readings confirmed, still pending: %u", (unsigned)telemetryBuffer.size());
+    }
+
+    if (telemetryBuffer.isEmpty() || !mqttClient.connected())
         return;
+#if MQTT_QOS
+    if (!mqttClient.canPublishConfirmed()) // Window full, wait for a PUBACK
+        return;
+    uint32_t from = nextDrainSequence > telemetryBuffer.oldestSequence() ? nextDrainSequence : telemetryBuffer.oldestSequence();
+#else
+    uint32_t from = telemetryBuffer.oldestSequence();
+#endif
+    if (from > telemetryBuffer.newestSequence()) // Everything left is in flight or unreadable
+    {
+        if (mqttClient.inFlight() == 0)
+            telemetryBuffer.release(telemetryBuffer.newestSequence());
+        return;
+    }
+
+    TelemetryRecord batch[TELEMETRY_BATCH_CAPACITY];
+    size_t count = telemetryBuffer.read(from, batch, TELEMETRY_BATCH_CAPACITY);
+    if (count == 0) // Only unreadable slots are left, skip them
+    {
+        nextDrainSequence = telemetryBuffer.newestSequence() + 1;
+        if (mqttClient.inFlight() == 0)
+            telemetryBuffer.release(telemetryBuffer.newestSequence());
+        return;
+    }
+
+    // One message per loop iteration keeps the loop responsive. A slice that does not encode
+    // is sent in halves, so one oversized batch cannot hold up the ring
+    MqttTelemetryPublisher::Status status = mqttPublishMessage(batch, count, MQTT_QOS);
+    while ((status == MqttTelemetryPublisher::ArenaFull || status == MqttTelemetryPublisher::PayloadTooLarge) && count > 1)
+    {
+        count /= 2;
+        status = mqttPublishMessage(batch, count, MQTT_QOS);
+    }
+    if (status == MqttTelemetryPublisher::ArenaFull || status == MqttTelemetryPublisher::PayloadTooLarge) // Not even one reading encodes, skip it
+    {
+        LOG_ERROR("Buffered reading %lu does not encode, dropped", (unsigned long)batch[0].sequence);
+        metrics.increment(CounterDroppedSamples);
+        nextDrainSequence = batch[0].sequence + 1;
+        if (!MQTT_QOS || mqttClient.inFlight() == 0)
+            telemetryBuffer.release(batch[0].sequence);
+        return;
+    }
+    if (status == MqttTelemetryPublisher::Published)
+    {
+        nextDrainSequence = batch[count - 1].sequence + 1;
+        if (!MQTT_QOS) // QoS 0 has no PUBACK, the written batch counts as delivered
+        {
+            telemetryBuffer.release(batch[count - 1].sequence);
+            LOG_INFO("Buffered readings published: %u, still pending: %u", (unsigned)count, (unsigned)telemetryBuffer.size());
+        }
     }
-    Serial.println("AWS IoT Core is connected successfully!");
 }
 
-void mqttPublishMessage(float humidity, float temperatureC, float temperatureF, SensorConditionStatus condition) // Function to publish message to AWS IoT Core
+const char *conditionToString(SensorConditionStatus condition) // Function to convert a condition to its status string
 {
-    if (!mqttClient.connected()) // Check if the client is connected
+    return condition >= Normal && condition <= SensorError ? CONDITION_STRINGS[condition] : CONDITION_STRINGS[SensorError];
+}
+
+MqttTelemetryPublisher::Status mqttPublishMessage(const TelemetryRecord *records, size_t count, bool confirmed) // Function to publish message to AWS IoT Core
+{
+    if (!mqttClient.connected())                     // Check if the client is connected
+        return MqttTelemetryPublisher::NotConnected; // serviceAWSConnection() reconnects in the background
+    uint32_t freeHeapBefore = ESP.getFreeHeap(); // Heap before the publish path, for reportHeapUsage()
+
+    // Build and encode into the static arena and payload buffer, then publish, as the benchmark does
+    TelemetryEnvelope envelope = {"DHT11", deviceID, NULL, NULL, timezoneStr, dstStatus}; // Date and time are filled in by the publisher
+    MqttTelemetryPublisher::Status status = telemetryPublisher.publish(AWS_IOT_PUBLISH_TOPIC, records, count, envelope, TELEMETRY_FORMAT, confirmed);
+    if (status == MqttTelemetryPublisher::ArenaFull) // The document is incomplete
     {
-        connectAWS(); // Connect to AWS IoT Core if not connected
+        LOG_ERROR("JSON arena too small, not published");
+        return status;
     }
-    // Fetch the current time
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
+    if (status == MqttTelemetryPublisher::PayloadTooLarge)
+    {
+        LOG_ERROR("Payload does not fit the MQTT payload buffer, not published");
+        return status;
+    }
+    metrics.record(TimerJsonEncode, telemetryPublisher.lastEncodeUs());
+    metrics.record(TimerMqttPublish, telemetryPublisher.lastPublishUs());
+
+    bool published = status == MqttTelemetryPublisher::Published;
+    LOG_INFO("Message payload bytes: %u", (unsigned)telemetryPublisher.lastPayloadLength()); // Print the message size
+#if TELEMETRY_ENCODING == TELEMETRY_ENCODING_JSON
+    LOG_DEBUG_TEXT((const char *)telemetryPublisher.lastPayload(), telemetryPublisher.lastPayloadLength()); // Print the JSON data
+#endif
+    LOG_INFO("%s", published ? "Publish succeeded" : "Publish failed");
+    if (!published)
+        metrics.increment(CounterPublishFailures);
+    if (published && firstPublishTime == 0)
     {
-        Serial.println("Failed to obtain time");
-        return; // Don't proceed if time couldn't be obtained
+        firstPublishTime = millis();
+        LOG_INFO("Startup: first publish after %lu ms", firstPublishTime);
     }
 
-    // Format the date and time separately
-    char formattedDate[11]; // Buffer to hold the formatted date "mm-dd-yyyy"
-    char formattedTime[9];  // Buffer to hold the formatted time "hh:mm:ss"
+    int32_t heapDelta = (int32_t)freeHeapBefore - (int32_t)ESP.getFreeHeap(); // Positive if the publish kept heap memory
+    if (heapDelta > maxPublishHeapDelta)
+        maxPublishHeapDelta = heapDelta;
+    return status;
+}
 
-    // Use strftime to format the date and time separately
-    strftime(formattedDate, sizeof(formattedDate), "%m-%d-%Y", &timeinfo);
-    strftime(formattedTime, sizeof(formattedTime), "%H:%M:%S", &timeinfo);
+void reportHeapUsage() // Function to report heap and payload memory usage
+{
+    unsigned long currentMillis = millis();
+    if (currentMillis - lastHeapReportTime < HEAP_REPORT_INTERVAL_MS)
+        return;
+    lastHeapReportTime = currentMillis;
 
-    // Get Unix time
-    time_t unixTime = mktime(&timeinfo);
+    // The low-water mark stays flat over days once the publish path no longer allocates
+    LOG_DEBUG("Heap free: %lu bytes, low-water mark: %lu bytes, largest block: %lu bytes",
+              (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(), (unsigned long)ESP.getMaxAllocHeap());
+    LOG_DEBUG("JSON arena peak: %u of %u bytes, largest heap drop across a publish: %ld bytes",
+              (unsigned)jsonArena.peakUsage(), (unsigned)jsonArena.capacity(), (long)maxPublishHeapDelta);
+}
 
-    String conditionStr = condition == Normal ? "Normal" : condition == BelowNormal ? "Below Normal"
-                                                       : condition == AboveNormal   ? "Above Normal"
-                                                                                    : "Sensor Error";
+void publishMetrics() // Function to publish the runtime metrics
+{
+    if (METRICS_INTERVAL_MS == 0 || !mqttClient.connected())
+        return;
+    unsigned long currentMillis = millis();
+    if (lastMetricsTime != 0 && currentMillis - lastMetricsTime < METRICS_INTERVAL_MS)
+        return;
+    lastMetricsTime = currentMillis;
+
+    // Compact JSON written in place, {"up":s,"heap":[free,min,block],"<counter>":n,...,"<timer>":[count,mean,p90,max],...}
+    static char payload[320];
+    size_t length = snprintf(payload, sizeof(payload), "{\"up\":%lu,\"heap\":[%lu,%lu,%lu]", currentMillis / 1000,
+                             (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(), (unsigned long)ESP.getMaxAllocHeap());
+    for (size_t i = 0; i < METRIC_COUNTER_COUNT && length < sizeof(payload); i++)
+        length += snprintf(payload + length, sizeof(payload) - length, ",\"%s\":%lu", METRIC_COUNTER_NAMES[i], (unsigned long)metrics.counter(i));
+    for (size_t i = 0; i < METRIC_TIMER_COUNT && length < sizeof(payload); i++)
+    {
+        LatencySummary latency = metrics.takeLatency(i); // Every window starts at the previous message
+        length += snprintf(payload + length, sizeof(payload) - length, ",\"%s\":[%lu,%lu,%lu,%lu]", METRIC_TIMER_NAMES[i],
+                           (unsigned long)latency.count, (unsigned long)latency.meanUs, (unsigned long)latency.p90Us, (unsigned long)latency.maxUs);
+    }
+    if (length >= sizeof(payload) - 1) // No room for the closing brace
+    {
+        LOG_ERROR("Metrics do not fit their buffer, not published");
+        return;
+    }
+    payload[length++] = '}';
+    payload[length] = '\0';
 
-    // Create a JSON document
-    StaticJsonDocument<256> doc;
+    if (!mqttClient.publish(AWS_IOT_METRICS_TOPIC, (const uint8_t *)payload, length))
+        LOG_WARN("Metrics publish failed");
+}
 
-    // Populate document
-    doc["timeStamp"] = unixTime;
-    doc["deviceModel"] = "DHT11";
-    doc["deviceID"] = String(ESP.getEfuseMac(), HEX);
-    doc["status"] = conditionStr;
-    doc["date"] = formattedDate;
-    doc["time"] = formattedTime;
-    doc["timeZone"] = timezoneStr;
-    doc["DST"] = dstStatus;
-    JsonObject data = doc.createNestedObject("data"); // Create a nested object for data
-    data["temp_C"] = temperatureC;
-    data["temp_F"] = round(temperatureF);
-    data["humidity"] = humidity;
+SensorConditionStatus edgeCondition() // Function to map the confirmed aggregator state to a condition
+{
+    if (dhtAggregator.isFault())
+        return SensorError;
+    if (dhtAggregator.level(0) == EdgeLow || dhtAggregator.level(1) == EdgeLow) // Same order as checkSensorReadings()
+        return BelowNormal;
+    if (dhtAggregator.level(0) == EdgeHigh || dhtAggregator.level(1) == EdgeHigh)
+        return AboveNormal;
+    return Normal;
+}
 
-    String jsonString;                    // Create a string to hold the JSON data
-    serializeJson(doc, jsonString);       // Serialize the JSON document to a string
-    Serial.print("Publishing message: "); // Print the message
-    Serial.println(jsonString);           // Print the JSON data
+void postEdgeSummary(uint32_t nowMs) // Function to hand the window summary to the network task
+{
+    EdgeSummary summary = {};
+    summary.timestamp = isClockSet() ? time(nullptr) : 0;
+    summary.windowS = dhtAggregator.windowMs(nowMs) / 1000;
+    summary.faults = dhtAggregator.windowFaults();
+    summary.changes = dhtAggregator.stateChanges();
+    summary.condition = edgeCondition();
+    for (size_t i = 0; i < 2; i++)
+        summary.quantity[i] = dhtAggregator.windowStats(i);
+    dhtAggregator.startWindow(nowMs);
+    if (!summaryQueue.push(summary))
+        LOG_WARN("Summary queue full, window summary dropped");
+}
 
-    // Determine buffer size
-    size_t jsonSize = measureJson(doc) + 1; // +1 for null terminator
-    Serial.print("Calculated JSON buffer size: ");
-    Serial.println(jsonSize); // Print the buffer size
+void publishEdgeSummary(const EdgeSummary &summary) // Function to publish one window summary
+{
+    if (!mqttClient.connected())
+    {
+        LOG_WARN("Not connected, window summary dropped"); // Summaries are not kept, the next one follows
+        return;
+    }
 
-    if (!mqttClient.publish(AWS_IOT_PUBLISH_TOPIC.c_str(), jsonString.c_str()))
+    // Compact JSON written in place, "type" keeps the summaries apart from the readings in the Lambda
+    static char payload[384];
+    size_t length = snprintf(payload, sizeof(payload), "{\"type\":\"summary\",\"deviceID\":\"%s\",\"timeStamp\":%lu,\"timeZone\":\"%s\",\"status\":\"%s\",\"window\":%lu,\"faults\":%lu,\"changes\":%lu",
+                             deviceID, (unsigned long)summary.timestamp, timezoneStr, conditionToString((SensorConditionStatus)summary.condition),
+                             (unsigned long)summary.windowS, (unsigned long)summary.faults, (unsigned long)summary.changes);
+    if (length < sizeof(payload))
+        length += appendWindowStats(payload + length, sizeof(payload) - length, "temp_C", summary.quantity[0]);
+    if (length < sizeof(payload))
+        length += appendWindowStats(payload + length, sizeof(payload) - length, "humidity", summary.quantity[1]);
+    if (length >= sizeof(payload) - 1) // No room for the closing brace
     {
-        Serial.println("Publish failed");
+        LOG_ERROR("Window summary does not fit its buffer, not published");
+        return;
     }
-    else
+    payload[length++] = '}';
+    payload[length] = '\0';
+
+    LOG_DEBUG_TEXT(payload, length);
+    if (!mqttClient.publish(AWS_IOT_SUMMARY_TOPIC, (const uint8_t *)payload, length))
+        LOG_WARN("Window summary publish failed");
+}
+
+size_t appendWindowStats(char *out, size_t size, const char *name, const EdgeWindowStats &stats) // Function to format the statistics of one quantity
+{
+    if (stats.count == 0) // Only failed reads in the window
+        return snprintf(out, size, ",\"%s\":null", name);
+    return snprintf(out, size, ",\"%s\":{\"n\":%lu,\"mean\":%.2f,\"min\":%.2f,\"max\":%.2f,\"sd\":%.2f,\"ema\":%.2f}", name, (unsigned long)stats.count,
+                    stats.mean, stats.min, stats.max, sqrtf(stats.variance()), stats.ema);
+}
+
+void postIndicatorEvent(IndicatorEvent event) // Function to hand an indication to the indicator task
+{
+    if (indicatorQueue == NULL) // No indicator task in duty-cycled mode, show it while awake
+    {
+        applyIndicatorEvent(event);
+        return;
+    }
+    xQueueOverwrite(indicatorQueue, &event); // Only the latest condition matters, never blocks the sender
+}
+
+void indicateCondition(SensorConditionStatus condition) // Function to show a condition on the LEDs and buzzer
+{
+    switch (condition)
+    {
+    case Normal:
+        postIndicatorEvent(IndicateNormal); // Indicate normal condition
+        break;
+    case BelowNormal:
+        postIndicatorEvent(IndicateBelowRange); // Indicate condition below range
+        break;
+    case AboveNormal:
+        postIndicatorEvent(IndicateAboveRange); // Indicate condition above range
+        break;
+    default:
+        postIndicatorEvent(IndicateSensorError); // Indicate sensor error
+        break;
+    }
+}
+
+void sensorTask(void *parameter) // Task sampling the DHT11 at an adaptive period
+{
+    DHT11Reading reading;
+    TickType_t lastWakeTime = xTaskGetTickCount();
+
+    while (true)
+    {
+        checkSensorReadings(reading); // Read sensor and update humidity and temperature
+
+        TelemetryRecord record;
+        if (reading.status == DHT11_OK) // Check if the readings are valid
+        {
+            // Reset sensor error count upon successful reading
+            sensorErrorCount = 0;
+            record = makeTelemetryRecord(reading.humidity, reading.temperatureC, currentCondition);
+        }
+        else
+        {
+            // Handle sensor errors
+            sensorErrorCount++;                                       // Increment sensor error count
+            record = makeTelemetryRecord(NAN, NAN, currentCondition); // Publish sensor error to AWS IoT Core
+        }
+        bool isRebooting = sensorErrorCount >= MAX_SENSOR_ERROR_RETRIES;
+
+        // Hand a changed reading to the network task, never wait on it
+        float values[] = {reading.temperatureC, reading.humidity}; // NAN on a sensor error
+        bool isReported = !SAMPLING_ADAPTIVE || dhtSampling.update(values, millis()); // Also sets the sampling period
+#if EDGE_AGGREGATION
+        // Readings carry the confirmed condition, a confirmed change is published at once past the batch
+        if (dhtAggregator.update(values))
+        {
+            record.flags |= TELEMETRY_FLAG_FLUSH;
+            isReported = true; // Next to the deadband, boundary and heartbeat reports of dhtSampling
+        }
+        record.condition = edgeCondition();
+        if (dhtAggregator.windowMs(millis()) >= EDGE_SUMMARY_INTERVAL_MS)
+            postEdgeSummary(millis());
+#endif
+        indicateCondition((SensorConditionStatus)record.condition); // The confirmed condition with EDGE_AGGREGATION, as the cloud sees it
+        if (isRebooting)
+        {
+            LOG_ERROR("Maximum sensor error retries reached. Rebooting...");
+            isReported = true; // The last error reading goes out before the reboot
+        }
+        if (isReported)
+        {
+            if (telemetryQueue.push(record))
+            {
+                xTaskNotifyGive(networkTaskHandle); // Wake the network task, possibly on the other core
+            }
+            else
+            {
+                LOG_WARN("Telemetry queue full, reading dropped");
+                metrics.increment(CounterDroppedSamples);
+            }
+        }
+        if (isRebooting)
+        {
+            isRebootRequested.store(true); // After the reading, the network task publishes what is queued and reboots
+            xTaskNotifyGive(networkTaskHandle);
+            vTaskSuspend(NULL);
+        }
+
+        vTaskDelayUntil(&lastWakeTime, pdMS_TO_TICKS(dhtSampling.intervalMs())); // Period independent of the read time, faster near the thresholds
+    }
+}
+
+void networkTask(void *parameter) // Task owning the MQTT and TLS clients
+{
+    while (true)
+    {
+        serviceStartup(); // Bring up Wi-Fi, NTP and AWS IoT Core while the sensor task samples
+
+        // Wait briefly for a reading, the timeout keeps the connection serviced
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NETWORK_TASK_POLL_MS)); // Woken early by the sensor task
+        takeQueuedReadings();
+        if (isRebootRequested.load())
+            rebootAfterFlush(); // The sensor keeps failing, does not return
+
+        serviceTelemetryBatch(); // Publish a partial batch that has waited long enough
+        serviceAWSConnection();  // Advance the AWS IoT Core connection by one step
+        mqttClient.loop();       // Read PUBACKs and keep the session alive
+        drainTelemetryBuffer();  // Publish readings buffered during an outage
+        reportHeapUsage();       // Report heap usage once per interval
+        publishMetrics();        // Publish the runtime metrics once per interval
+        serviceOta();            // Start a firmware job and report its result
+
+        EdgeSummary summary;
+        if (summaryQueue.pop(summary))
+            publishEdgeSummary(summary); // Publish the window summary of the sensor task
+    }
+}
+
+void takeQueuedReadings() // Function to move the readings of the sensor task into the batch
+{
+    TelemetryRecord record;
+    while (telemetryQueue.pop(record))
+    {
+        bool isUrgent = record.condition == SensorError || record.condition != lastQueuedCondition || (record.flags & TELEMETRY_FLAG_FLUSH); // Alarms never wait for a full batch
+        lastQueuedCondition = record.condition;
+        record.flags &= ~TELEMETRY_FLAG_FLUSH; // Only meant for the network task, not for the flash ring
+        queueTelemetryRecord(record); // Publish with its batch, or keep it in flash until the session is back
+        if (isUrgent)
+            flushTelemetryBatch(); // Report the change or the error now, as runDutyCycle() does
+    }
+}
+
+void rebootAfterFlush() // Function to publish the pending readings, then reboot
+{
+    takeQueuedReadings();
+    flushTelemetryBatch(); // RAM batches are lost on a reset, the flash ring is not
+
+    // Give the session a moment to publish the ring, QoS 1 batches until their PUBACK
+    unsigned long startTime = millis();
+    while (!telemetryBuffer.isEmpty() && mqttClient.connected() && millis() - startTime < REBOOT_FLUSH_TIMEOUT_MS)
+    {
+        mqttClient.loop();
+        drainTelemetryBuffer();
+        delay(1);
+    }
+    if (mqttClient.connected())
+        mqttClient.disconnect();
+    LOG_FLUSH();
+    delay(ESP32_REBOOT_DELAY_MS);
+    ESP.restart(); // Reboot the device
+}
+
+void serviceStartup() // Function to advance the startup pipeline by one stage
+{
+    switch (startupStage)
+    {
+    case StartupConnectingWiFi:
+        connectToWiFi(); // Blocks only this task, reboots if Wi-Fi stays down
+        LOG_INFO("Startup: WiFi connected after %lu ms", millis());
+
+        syncNTP();    // Runs in the background in the lwIP task
+        connectAWS(); // The TLS handshake overlaps with the time sync
+#if PING_ON_STARTUP
+        startTask(pingTask, "ping", PING_TASK_STACK_SIZE, NETWORK_TASK_PRIORITY, PROTOCOL_CORE, NULL);
+#endif
+        startupStage = StartupSyncingTime;
+        break;
+
+    case StartupSyncingTime:
+        if (!isClockSet())
+            break;
+        LOG_INFO("Startup: time synchronized after %lu ms, held readings: %u", millis(), (unsigned)preSyncBacklogCount);
+
+        startupStage = StartupOnline;
+        for (size_t i = 0; i < preSyncBacklogCount; i++)
+            queueTelemetryRecord(preSyncBacklog[i]); // Time stamps are fixed up on the way in
+        preSyncBacklogCount = 0;
+        break;
+
+    case StartupOnline:
+        break;
+    }
+}
+
+bool startTask(TaskFunction_t task, const char *name, uint32_t stackSize, UBaseType_t priority, BaseType_t core, TaskHandle_t *handle) // Function to create a task on its core
+{
+    BaseType_t affinity = IS_CORE_PINNED ? core : tskNO_AFFINITY; // The scheduler places it on a single-core chip
+    return xTaskCreatePinnedToCore(task, name, stackSize, NULL, priority, handle, affinity) == pdPASS;
+}
+
+void pingTask(void *parameter) // Task running the one-off ping diagnostic
+{
+    pingHost();        // Blocking ICMP round trip, nothing else waits on it
+    vTaskDelete(NULL); // One-off task
+}
+
+void onMqttMessage(const char *topic, const uint8_t *payload, size_t length) // Callback of the MQTT session for the AWS IoT jobs topics
+{
+#if OTA_ENABLED
+    if (strcmp(topic, AWS_IOT_JOBS_NOTIFY_TOPIC) != 0 && strcmp(topic, AWS_IOT_JOBS_ACCEPTED_TOPIC) != 0)
+        return;
+    OtaState state = otaUpdater.state();
+    if (isOtaJobPending || state == OtaRunning || state == OtaReady) // One update at a time, repeats of the running job included
+        return;
+
+    JsonDocument doc; // A few KB a few times per update, on the heap instead of the telemetry arena
+    if (deserializeJson(doc, payload, length))
+    {
+        LOG_WARN("OTA: unreadable job message");
+        return;
+    }
+    JsonObjectConst execution = doc["execution"];
+    const char *jobId = execution["jobId"];
+    if (jobId == nullptr) // No job queued
+        return;
+    JsonObjectConst ota = execution["jobDocument"]["ota"];
+    const char *url = ota["url"] | "";
+    const char *signature = ota["signature"] | "";
+    const char *baseMd5 = ota["baseMd5"] | ""; // Set for a delta image
+    uint32_t size = ota["size"] | 0;
+    if (strlen(jobId) >= sizeof(otaJob.jobId) || strlen(url) >= sizeof(otaJob.url) || strlen(baseMd5) >= sizeof(otaJob.baseMd5) || url[0] == 0 || signature[0] == 0 || size == 0 ||
+        mbedtls_base64_decode(otaJob.signature, sizeof(otaJob.signature), &otaJob.signatureLength, (const unsigned char *)signature, strlen(signature)) != 0)
+    {
+        LOG_WARN("OTA: job %s has no usable ota document", jobId);
+        return;
+    }
+    strcpy(otaJob.jobId, jobId);
+    strcpy(otaJob.url, url);
+    strcpy(otaJob.baseMd5, baseMd5);
+    otaJob.size = size;
+    isOtaJobPending = true; // Published from serviceOta(), not from inside mqttClient.loop()
+#endif
+}
+
+void serviceOta() // Function to start a received firmware job and report how it ends
+{
+#if OTA_ENABLED
+    if (isOtaJobPending && mqttClient.connected())
+    {
+        isOtaJobPending = false;
+        if (otaUpdater.start(otaJob, NETWORK_TASK_PRIORITY, IS_CORE_PINNED ? PROTOCOL_CORE : tskNO_AFFINITY))
+        {
+            LOG_INFO("OTA: job %s, %s image of %lu bytes", otaJob.jobId, otaJob.baseMd5[0] ? "delta" : "full", (unsigned long)otaJob.size);
+            publishJobStatus("IN_PROGRESS", NULL);
+        }
+        else if (otaUpdater.state() != OtaFailed) // A failed start is reported as FAILED below
+        {
+            publishJobStatus("REJECTED", "No signing key on the device");
+        }
+        return;
+    }
+
+    switch (otaUpdater.state())
+    {
+    case OtaReady:
+        if (!mqttClient.connected()) // Report first, AWS IoT jobs would hand the job out again after the restart
+            return;
+        publishJobStatus("SUCCEEDED", NULL);
+        LOG_INFO("OTA: image verified, restarting into it");
+        LOG_FLUSH();
+        mqttClient.disconnect();
+        delay(100); // DISCONNECT on its way before the radio goes down
+        ESP.restart();
+        break;
+    case OtaFailed:
+        if (!mqttClient.connected())
+            return;
+        LOG_WARN("OTA: job %s failed: %s", otaJob.jobId, otaUpdater.failureReason());
+        publishJobStatus("FAILED", otaUpdater.failureReason());
+        otaUpdater.clear(); // Ready for the next job
+        break;
+    default:
+        break;
+    }
+#endif
+}
+
+void publishJobStatus(const char *status, const char *reason) // Function to report the firmware job state to AWS IoT jobs
+{
+#if OTA_ENABLED
+    char topic[sizeof(deviceID) + sizeof(otaJob.jobId) + 24];
+    snprintf(topic, sizeof(topic), "$aws/things/%s/jobs/%s/update", deviceID, otaJob.jobId);
+    char payload[160];
+    size_t length = reason != NULL ? snprintf(payload, sizeof(payload), "{\"status\":\"%s\",\"statusDetails\":{\"reason\":\"%s\"}}", status, reason)
+                                   : snprintf(payload, sizeof(payload), "{\"status\":\"%s\"}", status);
+    if (length >= sizeof(payload) || !mqttClient.publish(topic, (const uint8_t *)payload, length))
+        LOG_WARN("OTA: job status %s not published", status);
+#endif
+}
+
+void indicatorTask(void *parameter) // Task owning the LEDs and the buzzer
+{
+    IndicatorEvent event;
+    while (true)
     {
-        Serial.println("Publish succeeded");
+        // Sleep until a new indication, the blink steps are timed by the indicator engine
+        if (xQueueReceive(indicatorQueue, &event, portMAX_DELAY) == pdTRUE)
+        {
+            applyIndicatorEvent(event);
+        }
     }
 }
+
+void applyIndicatorEvent(IndicatorEvent event) // Function to drive the LEDs and buzzer for an indication
+{
+    switch (event)
+    {
+    case IndicateNormal:
+        indicateNormalCondition(); // Indicate normal condition
+        break;
+    case IndicateBelowRange:
+        indicateConditionBelowRange(); // Indicate condition below range
+        break;
+    case IndicateAboveRange:
+        indicateConditionAboveRange(); // Indicate condition above range
+        break;
+    case IndicateSensorError:
+        indicateSensorError(); // Indicate sensor error
+        break;
+    }
+}
+
+void runDutyCycle() // Function to run one duty-cycled wake-up, ends in deep sleep
+{
+    rtcCycleCount++;
+    bool connected = false;
+
+    // Without a valid clock the reading would get a 1970 time stamp, sync first
+    if (time(nullptr) < VALID_TIME_EPOCH)
+    {
+        connected = connectForDutyCycle();
+        if (WiFi.status() == WL_CONNECTED)
+        {
+            syncNTP();
+            struct tm timeinfo;
+            if (!getLocalTime(&timeinfo, DUTY_NTP_TIMEOUT_MS))
+                LOG_WARN("NTP time sync failed");
+        }
+    }
+
+    // Sample once, the DHT11 stays powered during deep sleep
+    unsigned long sampleStart = millis();
+    DHT11Reading reading;
+    checkSensorReadings(reading);
+    indicateCondition(currentCondition);
+    TelemetryRecord record = reading.status == DHT11_OK ? makeTelemetryRecord(reading.humidity, reading.temperatureC, currentCondition)
+                                                        : makeTelemetryRecord(NAN, NAN, currentCondition);
+    unsigned long sampleTime = millis() - sampleStart;
+
+    // Only wake the radio for a full batch or a condition change
+    bool conditionChanged = currentCondition != rtcLastCondition;
+    rtcLastCondition = currentCondition;
+    bool batchFull = telemetryBatchCount + 1 >= TELEMETRY_BATCH_CAPACITY;
+
+    unsigned long networkStart = millis();
+    if ((batchFull || conditionChanged) && !connected)
+        connected = connectForDutyCycle();
+
+    queueTelemetryRecord(record); // Publishes or moves to flash when the batch is full
+    if (conditionChanged)
+        flushTelemetryBatch(); // Report the change now, not when the batch fills
+    while (connected && !telemetryBuffer.isEmpty() && mqttClient.connected())
+    {
+        mqttClient.loop();      // PUBACKs of the QoS 1 batches, a silent broker ends the session
+        drainTelemetryBuffer(); // Catch up on readings stored by earlier failed cycles
+        delay(1);
+    }
+
+    if (connected)
+    {
+        mqttClient.disconnect();
+        net.stop();
+    }
+    if (preSyncBacklogCount > 0) // Seconds since boot restart on wake-up, these cannot be fixed up later
+        LOG_WARN("NTP time not set, reading dropped");
+    WiFi.disconnect(true); // Radio off before sleeping
+    WiFi.mode(WIFI_OFF);
+    unsigned long networkTime = millis() - networkStart;
+
+    // Report the wake-to-sleep budget, millis() counts from application start
+    unsigned long awakeTime = millis();
+    if (awakeTime > rtcMaxAwakeMs)
+        rtcMaxAwakeMs = awakeTime;
+    unsigned long sleepTime = awakeTime + DUTY_MIN_SLEEP_MS < DUTY_CYCLE_INTERVAL_MS ? DUTY_CYCLE_INTERVAL_MS - awakeTime : DUTY_MIN_SLEEP_MS;
+
+    LOG_INFO("Duty cycle %lu: sample %lu ms, network %lu ms, awake %lu ms (max %lu ms), batched readings: %u, sleeping %lu ms",
+             (unsigned long)rtcCycleCount, sampleTime, networkTime, awakeTime, (unsigned long)rtcMaxAwakeMs, (unsigned)telemetryBatchCount, sleepTime);
+    LOG_FLUSH(); // Out of the ring and the UART before the CPU stops
+
+    esp_sleep_enable_timer_wakeup((uint64_t)sleepTime * 1000ULL);
+    esp_deep_sleep_start(); // Does not return, the next wake-up starts in setup()
+}
+
+bool connectForDutyCycle() // Function to bring up Wi-Fi and AWS IoT Core with timeouts
+{
+    WiFi.mode(WIFI_STA);
+    configureWiFiAddress();
+
+    // Directed association to the last access point skips the channel scan
+    if (!wifiCache.connectCached(ssid, password, WIFI_FAST_CONNECT_TIMEOUT_MS, WIFI_USE_CACHED_LEASE))
+    {
+        WiFi.begin(ssid, password); // Nothing cached or the access point moved, scan
+        WiFiCache::waitForConnection(DUTY_WIFI_TIMEOUT_MS);
+    }
+
+    if (WiFi.status() != WL_CONNECTED)
+    {
+        LOG_WARN("WiFi connection failed, readings stay buffered");
+        return false;
+    }
+    wifiCache.save();
+
+    connectAWS(); // Starts the first attempt, serviceAWSConnection() finishes it
+    unsigned long start = millis();
+    while (!mqttClient.connected() && millis() - start < DUTY_AWS_TIMEOUT_MS)
+    {
+        serviceAWSConnection();
+        delay(1);
+    }
+    if (!mqttClient.connected())
+        LOG_WARN("AWS IoT Core connection timed out, readings stay buffered");
+    return mqttClient.connected();
+}
+
+void configureWiFiAddress() // Function to apply the static IP from build_flags, if any
+{
+#ifdef WIFI_STATIC_IP
+    if (!WiFiCache::configureStaticIP(WIFI_STATIC_IP, WIFI_STATIC_GATEWAY, WIFI_STATIC_SUBNET, WIFI_STATIC_DNS))
+        LOG_WARN("Invalid static IP settings, using DHCP");
+#endif
+}